@@ -0,0 +1,216 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "dumps.h"
+#include "dumpanalyzer.h"
+#include "exceptions.h"
+
+#define DUMP_MAGIC_0    0xDEADC0DE
+#define DUMP_MAGIC_1    0xDEADCAFE
+#define MIN_VERSION     ((1 << 16) | 2)
+
+static void addDump(const char *path, Dump **dumps, u32 *count)
+{
+    static u32 capacity = 0;
+
+    if(*count == capacity)
+    {
+        capacity = capacity != 0 ? capacity * 2 : 256;
+        *dumps = realloc(*dumps, capacity * sizeof(Dump));
+        if(*dumps == NULL) fail("out of memory");
+    }
+
+    Dump *dump = &(*dumps)[(*count)++];
+    memset(dump, 0, sizeof(Dump));
+    dump->path = strdup(path);
+    if(dump->path == NULL) fail("out of memory");
+}
+
+static int compareNames(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static bool isDumpName(const char *name)
+{
+    size_t length = strlen(name);
+
+    return length >= 4 && strcmp(name + length - 4, ".dmp") == 0;
+}
+
+void findDumps(const char *path, Dump **dumps, u32 *count)
+{
+    struct stat info;
+
+    if(stat(path, &info) != 0 || !S_ISDIR(info.st_mode))
+    {
+        //Missing files show up as unreadable dumps
+        addDump(path, dumps, count);
+        return;
+    }
+
+    DIR *dir = opendir(path);
+    if(dir == NULL) fail("can't open %s", path);
+
+    //Sorted, so that the dumps of a bucket are listed in order
+    char **names = NULL;
+    u32 nameCount = 0,
+        capacity = 0;
+
+    for(struct dirent *entry; (entry = readdir(dir)) != NULL;)
+    {
+        if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+        if(nameCount == capacity)
+        {
+            capacity = capacity != 0 ? capacity * 2 : 64;
+            names = realloc(names, capacity * sizeof(char *));
+            if(names == NULL) fail("out of memory");
+        }
+
+        names[nameCount] = malloc(strlen(path) + strlen(entry->d_name) + 2);
+        if(names[nameCount] == NULL) fail("out of memory");
+        sprintf(names[nameCount++], "%s/%s", path, entry->d_name);
+    }
+
+    closedir(dir);
+    qsort(names, nameCount, sizeof(char *), compareNames);
+
+    for(u32 i = 0; i < nameCount; i++)
+    {
+        if(stat(names[i], &info) == 0 && S_ISDIR(info.st_mode)) findDumps(names[i], dumps, count);
+        else if(isDumpName(names[i])) addDump(names[i], dumps, count);
+
+        free(names[i]);
+    }
+
+    free(names);
+}
+
+static u32 read32(const u8 *src)
+{
+    return src[0] | (src[1] << 8) | (src[2] << 16) | ((u32)src[3] << 24);
+}
+
+static const char *parseMapping(Dump *dump, const u8 *data, u32 size)
+{
+    ExceptionDumpHeader header;
+
+    if(size < sizeof(header)) return "invalid file format";
+    memcpy(&header, data, sizeof(header));
+
+    if(header.magic[0] != DUMP_MAGIC_0 || header.magic[1] != DUMP_MAGIC_1) return "invalid file format";
+    if(((u32)header.versionMajor << 16 | header.versionMinor) < MIN_VERSION) return "incompatible format version";
+
+    u32 registerCount = header.registerDumpSize / 4;
+    if(header.totalSize > size || registerCount < 16 || sizeof(header) + registerCount * 4 > size) return "truncated dump";
+
+    const u8 *registers = data + sizeof(header);
+    dump->processor = header.processor;
+    dump->type = header.type;
+    dump->lr = read32(registers + 14 * 4);
+    dump->pc = read32(registers + 15 * 4);
+
+    u64 additionalDataOffset = (u64)sizeof(header) + registerCount * 4 + header.codeDumpSize + header.stackDumpSize;
+    if(header.additionalDataSize >= 16 && additionalDataOffset + 16 <= size)
+    {
+        const u8 *additionalData = data + additionalDataOffset;
+
+        memcpy(dump->processName, additionalData, 8);
+        dump->processName[8] = 0;
+        dump->titleId = read32(additionalData + 8) | (u64)read32(additionalData + 12) << 32;
+    }
+
+    return NULL;
+}
+
+static void parseDump(Dump *dump)
+{
+    int fd = open(dump->path, O_RDONLY);
+    struct stat info;
+
+    if(fd < 0 || fstat(fd, &info) != 0)
+    {
+        dump->error = "can't open";
+        if(fd >= 0) close(fd);
+        return;
+    }
+
+    if(info.st_size < (off_t)sizeof(ExceptionDumpHeader) || info.st_size > 0xFFFFFFFF) dump->error = "invalid file format";
+    else
+    {
+        u8 *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if(data == MAP_FAILED) dump->error = "can't map";
+        else
+        {
+            dump->error = parseMapping(dump, data, (u32)info.st_size);
+            munmap(data, info.st_size);
+        }
+    }
+
+    close(fd);
+}
+
+typedef struct ParseQueue
+{
+    Dump *dumps;
+    u32 count;
+    u32 next;
+} ParseQueue;
+
+static void *parseThread(void *argument)
+{
+    ParseQueue *queue = argument;
+
+    for(u32 i; (i = __atomic_fetch_add(&queue->next, 1, __ATOMIC_RELAXED)) < queue->count;)
+        parseDump(&queue->dumps[i]);
+
+    return NULL;
+}
+
+void parseDumps(Dump *dumps, u32 count, u32 threads)
+{
+    ParseQueue queue = {dumps, count, 0};
+    pthread_t *threadIds = malloc(threads * sizeof(pthread_t));
+    u32 started = 0;
+
+    if(threadIds == NULL) fail("out of memory");
+
+    for(; started < threads && started < count; started++)
+        if(pthread_create(&threadIds[started], NULL, parseThread, &queue) != 0) break;
+
+    //Whatever couldn't be handed to a thread gets parsed here
+    parseThread(&queue);
+
+    for(u32 i = 0; i < started; i++) pthread_join(threadIds[i], NULL);
+
+    free(threadIds);
+}
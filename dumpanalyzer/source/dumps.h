@@ -0,0 +1,48 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   Exception dumps (format v1.2 and later) reduced to what the buckets need
+*/
+
+#pragma once
+
+#include "types.h"
+
+typedef struct Dump
+{
+    const char *path;
+    const char *error; //NULL if the dump could be parsed
+
+    u32 processor;
+    u32 type;
+    char processName[9];
+    u64 titleId;
+    u32 pc;
+    u32 lr;
+} Dump;
+
+//Adds the .dmp files under a directory (or the file itself) to the list
+void findDumps(const char *path, Dump **dumps, u32 *count);
+
+//Parses all the dumps, on the given number of threads
+void parseDumps(Dump *dumps, u32 count, u32 threads);
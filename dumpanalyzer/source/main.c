@@ -0,0 +1,246 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   dumpanalyzer: aggregates whole directories of exception dumps (format v1.2 and later). Crashes are bucketed by
+*   (processor, exception type, process name, title ID, faulting PC), and the PC and LR are symbolized against
+*   user-provided ELF, map or nm files
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "dumpanalyzer.h"
+#include "dumps.h"
+#include "symbols.h"
+
+#define MAX_SYMBOL_TABLES 32
+
+typedef struct Bucket
+{
+    const Dump *first; //Dumps of a bucket are contiguous once sorted
+    u32 count;
+    u32 lr;            //Most common LR
+} Bucket;
+
+static const char *exceptionNames[] = {"FIQ", "undefined instruction", "prefetch abort", "data abort"};
+
+static SymbolTable tables[MAX_SYMBOL_TABLES];
+static u32 tableCount = 0;
+
+void fail(const char *message, ...)
+{
+    va_list arguments;
+
+    fflush(stdout);
+    va_start(arguments, message);
+    fprintf(stderr, "dumpanalyzer: ");
+    vfprintf(stderr, message, arguments);
+    fputc('\n', stderr);
+    va_end(arguments);
+
+    exit(1);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: dumpanalyzer [-s [PROCESS=]FILE]... [-j THREADS] [-n TOP] [-v] <dumps or directories>...\n\n"
+                    "Parses exception dumps (e.g. copies of /puma/dumps) in parallel and lists the crashes by\n"
+                    "(processor, exception type, process name, title ID, PC), biggest buckets first.\n"
+                    "-s: ELF, map or nm file to symbolize the PC and the most common LR with, restricted to one\n"
+                    "    process name with PROCESS= ('arm9' for ARM9 dumps). Can be given several times.\n"
+                    "-j: number of parser threads (default: one per CPU)\n"
+                    "-n: only show the TOP biggest buckets\n"
+                    "-v: list the dumps of each bucket\n");
+    exit(1);
+}
+
+static int compareKeys(const Dump *a, const Dump *b)
+{
+    if(a->processor != b->processor) return a->processor < b->processor ? -1 : 1;
+    if(a->type != b->type) return a->type < b->type ? -1 : 1;
+
+    int names = strcmp(a->processName, b->processName);
+    if(names != 0) return names;
+
+    if(a->titleId != b->titleId) return a->titleId < b->titleId ? -1 : 1;
+    if(a->pc != b->pc) return a->pc < b->pc ? -1 : 1;
+
+    return 0;
+}
+
+static int compareDumps(const void *a, const void *b)
+{
+    const Dump *dumpA = a,
+               *dumpB = b;
+
+    //Unreadable dumps last
+    if((dumpA->error == NULL) != (dumpB->error == NULL)) return dumpA->error == NULL ? -1 : 1;
+
+    int keys = dumpA->error == NULL ? compareKeys(dumpA, dumpB) : 0;
+
+    return keys != 0 ? keys : strcmp(dumpA->path, dumpB->path);
+}
+
+static int compareBuckets(const void *a, const void *b)
+{
+    const Bucket *bucketA = a,
+                 *bucketB = b;
+
+    if(bucketA->count != bucketB->count) return bucketA->count > bucketB->count ? -1 : 1;
+
+    return compareKeys(bucketA->first, bucketB->first);
+}
+
+static int compareAddresses(const void *a, const void *b)
+{
+    u32 addressA = *(const u32 *)a,
+        addressB = *(const u32 *)b;
+
+    return addressA < addressB ? -1 : addressA > addressB;
+}
+
+//Most common value, the lowest one on ties
+static u32 mostCommon(u32 *values, u32 count)
+{
+    u32 best = values[0],
+        bestCount = 0;
+
+    qsort(values, count, sizeof(u32), compareAddresses);
+
+    for(u32 i = 0; i < count;)
+    {
+        u32 j = i;
+        while(j < count && values[j] == values[i]) j++;
+
+        if(j - i > bestCount)
+        {
+            best = values[i];
+            bestCount = j - i;
+        }
+
+        i = j;
+    }
+
+    return best;
+}
+
+static const char *symbolize(const char *process, u32 address, char *out, u32 outSize)
+{
+    for(u32 i = 0; i < tableCount; i++)
+    {
+        if(tables[i].process != NULL && strcmp(tables[i].process, process) != 0) continue;
+        if(lookupSymbol(&tables[i], address, out, outSize)) return out;
+    }
+
+    return "";
+}
+
+int main(int argc, char **argv)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    u32 threads = cpus > 0 ? (u32)cpus : 1,
+        top = 0;
+    bool verbose = false;
+    int i;
+
+    for(i = 1; i < argc && argv[i][0] == '-'; i++)
+    {
+        if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+        {
+            if(tableCount == MAX_SYMBOL_TABLES) fail("too many symbol files");
+
+            char *spec = argv[++i],
+                 *separator = strrchr(spec, '=');
+            SymbolTable *table = &tables[tableCount++];
+
+            if(separator != NULL) *separator = 0;
+            table->process = separator != NULL && separator != spec ? spec : NULL;
+            loadSymbols(table, separator != NULL ? separator + 1 : spec);
+        }
+        else if(strcmp(argv[i], "-j") == 0 && i + 1 < argc) threads = (u32)strtoul(argv[++i], NULL, 0);
+        else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) top = (u32)strtoul(argv[++i], NULL, 0);
+        else if(strcmp(argv[i], "-v") == 0) verbose = true;
+        else usage();
+    }
+
+    if(i == argc || threads == 0) usage();
+
+    Dump *dumps = NULL;
+    u32 count = 0;
+
+    for(; i < argc; i++) findDumps(argv[i], &dumps, &count);
+
+    parseDumps(dumps, count, threads);
+    qsort(dumps, count, sizeof(Dump), compareDumps);
+
+    //Group the sorted dumps
+    Bucket *buckets = malloc((count != 0 ? count : 1) * sizeof(Bucket));
+    u32 *lrs = malloc((count != 0 ? count : 1) * sizeof(u32));
+    u32 bucketCount = 0,
+        parsed = 0;
+
+    if(buckets == NULL || lrs == NULL) fail("out of memory");
+
+    while(parsed < count && dumps[parsed].error == NULL)
+    {
+        Bucket *bucket = &buckets[bucketCount++];
+        bucket->first = &dumps[parsed];
+        bucket->count = 0;
+
+        for(; parsed < count && dumps[parsed].error == NULL && compareKeys(bucket->first, &dumps[parsed]) == 0; parsed++)
+            lrs[bucket->count++] = dumps[parsed].lr;
+
+        bucket->lr = mostCommon(lrs, bucket->count);
+    }
+
+    qsort(buckets, bucketCount, sizeof(Bucket), compareBuckets);
+
+    printf("%u dumps, %u buckets, %u unreadable\n\n", parsed, bucketCount, count - parsed);
+    printf("%7s  %-9s%-24s%-10s%-18s%-10s%s\n", "Count", "CPU", "Exception", "Process", "Title ID", "PC", "Symbol (most common LR)");
+
+    for(u32 j = 0; j < bucketCount && (top == 0 || j < top); j++)
+    {
+        const Bucket *bucket = &buckets[j];
+        const Dump *dump = bucket->first;
+        const char *process = dump->processor == 9 ? "arm9" : dump->processName;
+        char titleId[17] = "-",
+             pcSymbol[256],
+             lrSymbol[256];
+
+        if(dump->processName[0] != 0) snprintf(titleId, sizeof(titleId), "%016llx", (unsigned long long)dump->titleId);
+
+        printf("%7u  %-9s%-24s%-10s%-18s%08x  %s (%08x %s)\n", bucket->count, dump->processor == 9 ? "ARM9" : "ARM11",
+               dump->type < sizeof(exceptionNames) / sizeof(exceptionNames[0]) ? exceptionNames[dump->type] : "unknown",
+               dump->processName[0] != 0 ? dump->processName : "-", titleId, dump->pc,
+               symbolize(process, dump->pc, pcSymbol, sizeof(pcSymbol)), bucket->lr,
+               symbolize(process, bucket->lr, lrSymbol, sizeof(lrSymbol)));
+
+        if(verbose)
+            for(u32 k = 0; k < bucket->count; k++) printf("         %s\n", dump[k].path);
+    }
+
+    for(u32 j = parsed; j < count; j++) printf("%s: %s\n", dumps[j].path, dumps[j].error);
+
+    return 0;
+}
@@ -0,0 +1,230 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include "symbols.h"
+#include "dumpanalyzer.h"
+
+#define SHT_SYMTAB 2
+#define STT_FUNC   2
+
+static u8 *readFile(const char *path, u32 *size)
+{
+    FILE *file = fopen(path, "rb");
+    if(file == NULL) fail("can't open %s", path);
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if(length < 0 || length > 0x7FFFFFFF) fail("can't read %s", path);
+
+    //Zero-terminated, for map and nm files
+    u8 *data = malloc(length + 1);
+    if(data == NULL) fail("out of memory");
+    if(fread(data, 1, length, file) != (size_t)length) fail("can't read %s", path);
+    data[length] = 0;
+
+    fclose(file);
+    *size = (u32)length;
+
+    return data;
+}
+
+static u16 read16(const u8 *src)
+{
+    return src[0] | (src[1] << 8);
+}
+
+static u32 read32(const u8 *src)
+{
+    return src[0] | (src[1] << 8) | (src[2] << 16) | ((u32)src[3] << 24);
+}
+
+static void addSymbol(SymbolTable *table, u32 *capacity, u32 address, u32 size, const char *name, u32 nameLength)
+{
+    if(table->count == *capacity)
+    {
+        *capacity = *capacity != 0 ? *capacity * 2 : 1024;
+        table->symbols = realloc(table->symbols, *capacity * sizeof(Symbol));
+        if(table->symbols == NULL) fail("out of memory");
+    }
+
+    Symbol *symbol = &table->symbols[table->count++];
+    symbol->address = address;
+    symbol->size = size;
+    symbol->name = strndup(name, nameLength);
+    if(symbol->name == NULL) fail("out of memory");
+}
+
+static void loadElf(SymbolTable *table, const char *path, const u8 *data, u32 size)
+{
+    u32 capacity = 0;
+
+    if(size < 0x34 || data[4] != 1 || data[5] != 1) fail("%s: only little-endian ELF32 files are supported", path);
+
+    u32 sectionsOffset = read32(data + 0x20);
+    u16 sectionSize = read16(data + 0x2E),
+        sectionCount = read16(data + 0x30);
+
+    if(sectionSize < 0x28 || (u64)sectionsOffset + (u64)sectionSize * sectionCount > size) fail("%s: truncated ELF file", path);
+
+    for(u32 i = 0; i < sectionCount; i++)
+    {
+        const u8 *section = data + sectionsOffset + i * sectionSize;
+        if(read32(section + 4) != SHT_SYMTAB) continue;
+
+        u32 offset = read32(section + 0x10),
+            symbolsSize = read32(section + 0x14),
+            link = read32(section + 0x18),
+            entrySize = read32(section + 0x24);
+
+        if(link >= sectionCount || entrySize < 0x10 || (u64)offset + symbolsSize > size) fail("%s: bad symbol table", path);
+
+        const u8 *strings = data + read32(data + sectionsOffset + link * sectionSize + 0x10);
+        u32 stringsSize = read32(data + sectionsOffset + link * sectionSize + 0x14);
+        if((u64)(strings - data) + stringsSize > size) fail("%s: bad string table", path);
+
+        for(u32 entry = offset; entry + entrySize <= offset + symbolsSize; entry += entrySize)
+        {
+            u32 nameOffset = read32(data + entry),
+                value = read32(data + entry + 4),
+                symbolSize = read32(data + entry + 8);
+            u8 type = data[entry + 12] & 0xF;
+            u16 sectionIndex = read16(data + entry + 14);
+
+            //Only functions, objects and untyped symbols defined in a section
+            if(type > STT_FUNC || sectionIndex == 0 || nameOffset == 0 || nameOffset >= stringsSize) continue;
+
+            const char *name = (const char *)strings + nameOffset;
+            u32 nameLength = strnlen(name, stringsSize - nameOffset);
+
+            //ARM mapping symbols
+            if(name[0] == '$') continue;
+
+            addSymbol(table, &capacity, type == STT_FUNC ? value & ~1 : value, symbolSize, name, nameLength);
+        }
+    }
+}
+
+static bool isSymbolStart(char c)
+{
+    return isalpha((unsigned char)c) || c == '_' || c == '.' || c == '$';
+}
+
+static bool isSymbolChar(char c)
+{
+    return isalnum((unsigned char)c) || c == '_' || c == '.' || c == '$' || c == '@';
+}
+
+//"[0x]address [type] name" lines, which is what both ld maps (symbol lines) and nm print
+static void loadMap(SymbolTable *table, char *text)
+{
+    u32 capacity = 0;
+
+    for(char *line = text; *line != 0;)
+    {
+        char *end = strchr(line, '\n');
+        if(end != NULL) *end = 0;
+
+        char *pos = line;
+        while(isspace((unsigned char)*pos)) pos++;
+        if(pos[0] == '0' && pos[1] == 'x') pos += 2;
+
+        char *digits = pos;
+        while(isxdigit((unsigned char)*pos)) pos++;
+        u32 digitCount = pos - digits;
+
+        if(digitCount >= 8 && digitCount <= 16 && isspace((unsigned char)*pos))
+        {
+            while(isspace((unsigned char)*pos)) pos++;
+
+            //nm type letter
+            if(isalpha((unsigned char)pos[0]) && isspace((unsigned char)pos[1]))
+                for(pos++; isspace((unsigned char)*pos); pos++);
+
+            char *name = pos;
+            if(isSymbolStart(*pos))
+            {
+                while(isSymbolChar(*pos)) pos++;
+                u32 nameLength = pos - name;
+                while(isspace((unsigned char)*pos)) pos++;
+
+                if(*pos == 0) addSymbol(table, &capacity, (u32)strtoull(digits, NULL, 16), 0, name, nameLength);
+            }
+        }
+
+        line = end != NULL ? end + 1 : line + strlen(line);
+    }
+}
+
+static int compareSymbols(const void *a, const void *b)
+{
+    const Symbol *symbolA = a,
+                 *symbolB = b;
+
+    if(symbolA->address != symbolB->address) return symbolA->address < symbolB->address ? -1 : 1;
+    if(symbolA->size != symbolB->size) return symbolA->size < symbolB->size ? -1 : 1;
+
+    return strcmp(symbolA->name, symbolB->name);
+}
+
+void loadSymbols(SymbolTable *table, const char *path)
+{
+    u32 size;
+    u8 *data = readFile(path, &size);
+
+    table->symbols = NULL;
+    table->count = 0;
+
+    if(size >= 4 && memcmp(data, "\x7F" "ELF", 4) == 0) loadElf(table, path, data, size);
+    else loadMap(table, (char *)data);
+
+    free(data);
+
+    qsort(table->symbols, table->count, sizeof(Symbol), compareSymbols);
+}
+
+bool lookupSymbol(const SymbolTable *table, u32 address, char *out, u32 outSize)
+{
+    //Last symbol at or below the address
+    u32 low = 0,
+        high = table->count;
+
+    while(low < high)
+    {
+        u32 middle = (low + high) / 2;
+
+        if(table->symbols[middle].address <= address) low = middle + 1;
+        else high = middle;
+    }
+
+    if(low == 0) return false;
+
+    const Symbol *symbol = &table->symbols[low - 1];
+    if(symbol->size != 0 && address >= symbol->address + symbol->size) return false;
+
+    snprintf(out, outSize, "%s+0x%x", symbol->name, address - symbol->address);
+
+    return true;
+}
@@ -0,0 +1,48 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   Address to symbol tables loaded from ELF32 files (.symtab), GNU ld map files or nm output
+*/
+
+#pragma once
+
+#include "types.h"
+
+typedef struct Symbol
+{
+    u32 address;
+    u32 size; //0 when unknown (map and nm files)
+    char *name;
+} Symbol;
+
+typedef struct SymbolTable
+{
+    const char *process; //Only used for dumps of this process ("arm9" for ARM9 dumps), NULL for all of them
+    Symbol *symbols;
+    u32 count;
+} SymbolTable;
+
+void loadSymbols(SymbolTable *table, const char *path);
+
+//"name+0xoffset", or false if the address isn't covered
+bool lookupSymbol(const SymbolTable *table, u32 address, char *out, u32 outSize);
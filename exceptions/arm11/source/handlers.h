@@ -24,6 +24,13 @@
 
 #include "types.h"
 
+//0x25000000 holds a ring of dump slots: the first one is the ARM9's, the others are claimed by the ARM11 cores
+//Each slot has room for a header, the registers, the code, a 16KB stack window and the ARM11 additional data
+#define DUMP_SLOT_SIZE          0x4400
+#define DUMP_SLOT_COUNT         16
+#define DUMP_ADDITIONAL_SIZE    16 //Process name and title ID
+#define DUMP_SLOT_BUSY          0xDEADBABE //magic[0] of a slot being written
+
 typedef struct __attribute__((packed))
 {
     u32 magic[2];
@@ -42,6 +49,7 @@ typedef struct __attribute__((packed))
 void __attribute__((noreturn)) mcuReboot(void);
 void cleanInvalidateDCacheAndDMB(void);
 bool cannotAccessVA(const void *address);
+bool claimDumpSlot(void *slot);
 void FIQHandler(void);
 void undefinedInstructionHandler(void);
 void dataAbortHandler(void);
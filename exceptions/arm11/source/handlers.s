@@ -148,3 +148,25 @@ cannotAccessVA:
     mrc p15,0,r0,c7,c4,0    @ read PA register
     and r0, #1              @ failure bit
     bx lr
+
+.global claimDumpSlot
+.type   claimDumpSlot, %function
+claimDumpSlot:
+    @ Atomically mark the slot as in use unless it holds a dump or is being written, returns 1 on success
+    ldr r2, =#0xdeadc0de
+    ldr r3, =#0xdeadbabe
+    claimLoop:
+        ldrex r1, [r0]
+        cmp r1, r2
+        cmpne r1, r3
+        beq slotNotFree
+        strex r1, r3, [r0]
+        cmp r1, #0
+        bne claimLoop
+    mov r0, #1
+    bx lr
+
+    slotNotFree:
+    clrex
+    mov r0, #0
+    bx lr
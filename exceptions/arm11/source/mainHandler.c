@@ -24,21 +24,86 @@
 
 #define REG_DUMP_SIZE   4 * 23
 #define CODE_DUMP_SIZE  48
+#define STACK_DUMP_SIZE 0x4000
+
+_Static_assert(sizeof(ExceptionDumpHeader) + REG_DUMP_SIZE + CODE_DUMP_SIZE + STACK_DUMP_SIZE + DUMP_ADDITIONAL_SIZE <= DUMP_SLOT_SIZE,
+               "a dump with a full stack window doesn't fit its slot");
 
 #define CODESET_OFFSET  0xBEEFBEEF
 
+#define DUMP_WAIT_SPINS 0x1000000 //Roughly 0.1s at 268MHz
+
+//Checks each page once, returns how many bytes starting from address can be read
+static u32 accessibleSize(const void *address, u32 size)
+{
+    u32 addr = (u32)address,
+        checked = 0;
+
+    while(checked < size && !cannotAccessVA((const void *)(addr + checked)))
+        checked += 0x1000 - ((addr + checked) & 0xFFF);
+
+    return checked < size ? checked : size;
+}
+
 static u32 __attribute__((noinline)) copyMemory(void *dst, const void *src, u32 size, u32 alignment)
 {
     u8 *out = (u8 *)dst;
     const u8 *in = (const u8 *)src;
 
-    if(((u32)src & (alignment - 1)) != 0 || cannotAccessVA(src) || (size != 0 && cannotAccessVA((u8 *)src + size - 1)))
+    if(((u32)src & (alignment - 1)) != 0 || accessibleSize(src, size) != size)
         return 0;
 
+    //The whole range is known to be valid now, copy it by blocks of words when possible
+    if((((u32)out | (u32)in) & 3) == 0)
+    {
+        u32 *out32 = (u32 *)out;
+        const u32 *in32 = (const u32 *)in;
+        u32 i = 0;
+
+        for(; i + 16 <= size; i += 16, out32 += 4, in32 += 4)
+        {
+            u32 a = in32[0], b = in32[1], c = in32[2], d = in32[3];
+            out32[0] = a;
+            out32[1] = b;
+            out32[2] = c;
+            out32[3] = d;
+        }
+
+        for(; i + 4 <= size; i += 4)
+            *out32++ = *in32++;
+
+        out = (u8 *)out32;
+        in = (const u8 *)in32;
+        size -= i;
+    }
+
     for(u32 i = 0; i < size; i++)
         *out++ = *in++;
 
-    return size;
+    return out - (u8 *)dst;
+}
+
+//Slots have room for the whole window, so the stack goes in uncompressed: compressing it here would make the
+//time spent in the handler grow with the stack, and the dump files are plain v1.2 anyway
+static u32 dumpStack(u8 *dst, u32 dstSize, const u8 *sp, u32 size)
+{
+    return copyMemory(dst, sp, size < dstSize ? size : dstSize, 1);
+}
+
+//Gives the other cores a chance to finish the dumps they're writing before rebooting, unless one of them hangs
+static void __attribute__((noreturn)) waitAndReboot(const u8 *dumpSlots, const u8 *ownSlot)
+{
+    for(u32 spins = 0; spins < DUMP_WAIT_SPINS; spins++)
+    {
+        bool busy = false;
+
+        for(const u8 *slot = dumpSlots + DUMP_SLOT_SIZE; slot < dumpSlots + DUMP_SLOT_COUNT * DUMP_SLOT_SIZE; slot += DUMP_SLOT_SIZE)
+            if(slot != ownSlot && *(vu32 *)slot == DUMP_SLOT_BUSY) busy = true;
+
+        if(!busy) break;
+    }
+
+    mcuReboot(); //Also contains DCache-cleaning code
 }
 
 void __attribute__((noreturn)) mainHandler(u32 *regs, u32 type, u32 cpuId)
@@ -47,10 +112,17 @@ void __attribute__((noreturn)) mainHandler(u32 *regs, u32 type, u32 cpuId)
 
     u32 registerDump[REG_DUMP_SIZE / 4];
     u8 codeDump[CODE_DUMP_SIZE];
-    u8 *const finalBuffer = cannotAccessVA((const void *)0xE5000000) ? (u8 *)0xF5000000 : (u8 *)0xE5000000; //VA for 0x25000000
-    u8 *final = finalBuffer;
+    u8 *const dumpSlots = cannotAccessVA((const void *)0xE5000000) ? (u8 *)0xF5000000 : (u8 *)0xE5000000; //VA for 0x25000000
+    u8 *finalBuffer = dumpSlots,
+       *final;
 
-    while(*(vu32 *)final == 0xDEADC0DE && *((vu32 *)final + 1) == 0xDEADCAFE);
+    //The first slot is the ARM9's. If every other one is taken, the dumps already there will have to do
+    do
+    {
+        finalBuffer += DUMP_SLOT_SIZE;
+        if(finalBuffer == dumpSlots + DUMP_SLOT_COUNT * DUMP_SLOT_SIZE) waitAndReboot(dumpSlots, NULL);
+    }
+    while(!claimDumpSlot(finalBuffer));
 
     dumpHeader.magic[0] = 0xDEADC0DE;
     dumpHeader.magic[1] = 0xDEADCAFE;
@@ -84,14 +156,14 @@ void __attribute__((noreturn)) mainHandler(u32 *regs, u32 type, u32 cpuId)
     final += copyMemory(final, registerDump, dumpHeader.registerDumpSize, 1);
     final += copyMemory(final, codeDump, dumpHeader.codeDumpSize, 1);
 
-    //Dump stack in place
-    dumpHeader.stackDumpSize = copyMemory(final, (const void *)registerDump[13], 0x1000 - (registerDump[13] & 0xFFF), 1);
+    //Dump stack in place, leaving room for the additional data
+    dumpHeader.stackDumpSize = dumpStack(final, DUMP_SLOT_SIZE - DUMP_ADDITIONAL_SIZE - (final - finalBuffer), (const u8 *)registerDump[13], accessibleSize((const void *)registerDump[13], STACK_DUMP_SIZE - (registerDump[13] & 0xFFF)));
     final += dumpHeader.stackDumpSize;
 
     if(!cannotAccessVA((u8 *)0xFFFF9004))
     {
         vu64 *additionalData = (vu64 *)final;
-        dumpHeader.additionalDataSize = 16;
+        dumpHeader.additionalDataSize = DUMP_ADDITIONAL_SIZE;
         vu8 *currentKCodeSet = *(vu8 **)(*(vu8 **)0xFFFF9004 + CODESET_OFFSET); //currentKProcess + CodeSet
 
         additionalData[0] = *(vu64 *)(currentKCodeSet + 0x50); //Process name
@@ -105,5 +177,5 @@ void __attribute__((noreturn)) mainHandler(u32 *regs, u32 type, u32 cpuId)
     *(ExceptionDumpHeader *)finalBuffer = dumpHeader;
 
     cleanInvalidateDCacheAndDMB();
-    mcuReboot(); //Also contains DCache-cleaning code
+    waitAndReboot(dumpSlots, finalBuffer);
 }
@@ -24,6 +24,12 @@
 
 #include "types.h"
 
+//0x25000000 holds a ring of dump slots: the first one is the ARM9's, the others are claimed by the ARM11 cores
+//Each slot has room for a header, the registers, the code, a 16KB stack window and the ARM11 additional data
+#define DUMP_SLOT_SIZE          0x4400
+#define DUMP_SLOT_COUNT         16
+#define DUMP_ADDITIONAL_SIZE    16 //Process name and title ID
+
 typedef struct __attribute__((packed))
 {
     u32 magic[2];
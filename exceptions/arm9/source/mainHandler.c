@@ -27,6 +27,17 @@
 
 #define REG_DUMP_SIZE   4 * 17
 #define CODE_DUMP_SIZE  48
+#define STACK_DUMP_SIZE 0x4000
+
+_Static_assert(sizeof(ExceptionDumpHeader) + REG_DUMP_SIZE + CODE_DUMP_SIZE + STACK_DUMP_SIZE + DUMP_ADDITIONAL_SIZE <= DUMP_SLOT_SIZE,
+               "a dump with a full stack window doesn't fit its slot");
+
+#ifdef EXCEPTIONS_HOST_MODEL
+//hostsim runs the handler on the host, see hostsim/source/exceptions.c
+void flushCaches(void);
+#else
+#define flushCaches() ((void (*)())0xFFFF0830)()
+#endif
 
 bool cannotAccessAddress(const void *address)
 {
@@ -51,18 +62,61 @@ bool cannotAccessAddress(const void *address)
     return true;
 }
 
+//Checks each page once, returns how many bytes starting from address can be read
+static u32 accessibleSize(const void *address, u32 size)
+{
+    u32 addr = (u32)address,
+        checked = 0;
+
+    while(checked < size && !cannotAccessAddress((const void *)(addr + checked)))
+        checked += 0x1000 - ((addr + checked) & 0xFFF);
+
+    return checked < size ? checked : size;
+}
+
 static u32 __attribute__((noinline)) copyMemory(void *dst, const void *src, u32 size, u32 alignment)
 {
     u8 *out = (u8 *)dst;
     const u8 *in = (const u8 *)src;
 
-    if(((u32)src & (alignment - 1)) != 0 || cannotAccessAddress(src) || (size != 0 && cannotAccessAddress((u8 *)src + size - 1)))
+    if(((u32)src & (alignment - 1)) != 0 || accessibleSize(src, size) != size)
         return 0;
 
+    //The whole range is known to be valid now, copy it by blocks of words when possible
+    if((((u32)out | (u32)in) & 3) == 0)
+    {
+        u32 *out32 = (u32 *)out;
+        const u32 *in32 = (const u32 *)in;
+        u32 i = 0;
+
+        for(; i + 16 <= size; i += 16, out32 += 4, in32 += 4)
+        {
+            u32 a = in32[0], b = in32[1], c = in32[2], d = in32[3];
+            out32[0] = a;
+            out32[1] = b;
+            out32[2] = c;
+            out32[3] = d;
+        }
+
+        for(; i + 4 <= size; i += 4)
+            *out32++ = *in32++;
+
+        out = (u8 *)out32;
+        in = (const u8 *)in32;
+        size -= i;
+    }
+
     for(u32 i = 0; i < size; i++)
         *out++ = *in++;
 
-    return size;
+    return out - (u8 *)dst;
+}
+
+//Slots have room for the whole window, so the stack goes in uncompressed: compressing it here would make the
+//time spent in the handler grow with the stack, and the dump files are plain v1.2 anyway
+static u32 dumpStack(u8 *dst, u32 dstSize, const u8 *sp, u32 size)
+{
+    return copyMemory(dst, sp, size < dstSize ? size : dstSize, 1);
 }
 
 void __attribute__((noreturn)) mainHandler(u32 *regs, u32 type)
@@ -105,14 +159,14 @@ void __attribute__((noreturn)) mainHandler(u32 *regs, u32 type)
     final += copyMemory(final, codeDump, dumpHeader.codeDumpSize, 1);
 
     //Dump stack in place
-    dumpHeader.stackDumpSize = copyMemory(final, (const void *)registerDump[13], 0x1000 - (registerDump[13] & 0xFFF), 1);
+    dumpHeader.stackDumpSize = dumpStack(final, DUMP_SLOT_SIZE - DUMP_ADDITIONAL_SIZE - (final - (u8 *)FINAL_BUFFER), (const u8 *)registerDump[13], accessibleSize((const void *)registerDump[13], STACK_DUMP_SIZE - (registerDump[13] & 0xFFF)));
 
     dumpHeader.totalSize = sizeof(ExceptionDumpHeader) + dumpHeader.registerDumpSize + dumpHeader.codeDumpSize + dumpHeader.stackDumpSize + dumpHeader.additionalDataSize;
 
     //Copy header (actually optimized by the compiler)
     *(ExceptionDumpHeader *)FINAL_BUFFER = dumpHeader;
 
-    ((void (*)())0xFFFF0830)(); //Ensure that all memory transfers have completed and that the data cache has been flushed
+    flushCaches(); //Ensure that all memory transfers have completed and that the data cache has been flushed
     i2cWriteRegister(I2C_DEV_MCU, 0x20, 1 << 2); //Reboot
     while(true);
 }
\ No newline at end of file
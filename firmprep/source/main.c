@@ -0,0 +1,224 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   firmprep: decrypts a NUS NATIVE_FIRM/TWL_FIRM/AGB_FIRM/SAFE_FIRM content with its cetk offline, using the payload's crypto.c,
+*   so that the payload finds a plain FIRM in /puma/firmware*.bin and skips decryptNusFirm at boot
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "types.h"
+#include "crypto.h"
+#include "softcrypto.h"
+#include "fatfs/sdmmc/sdmmc.h"
+
+#define MAX_FIRM_SIZE 0x400000 //Same limit as loadFirm
+#define CETK_SIZE     0xA50
+
+//Globals crypto.c expects from the rest of the payload
+bool isN3DS = false,
+     isDevUnit = false,
+     isA9lh = true;
+u32 emuOffset = 0;
+FirmwareSource firmSource = FIRMWARE_SYSNAND;
+
+//ctrNandRead and ctrNandInit aren't used here
+void sdmmc_sdcard_readsectors_submit(u32 sector_no, u32 numsectors, u8 *out)
+{
+    (void)sector_no; (void)numsectors; (void)out;
+}
+
+void sdmmc_nand_readsectors_submit(u32 sector_no, u32 numsectors, u8 *out)
+{
+    (void)sector_no; (void)numsectors; (void)out;
+}
+
+bool sdmmc_transfer_poll(u32 *doneSectors)
+{
+    if(doneSectors != NULL) *doneSectors = 0;
+    return true;
+}
+
+int sdmmc_transfer_wait(void)
+{
+    return -1;
+}
+
+mmcdevice *getMMCDevice(int drive)
+{
+    static mmcdevice device;
+
+    (void)drive;
+    return &device;
+}
+
+void sdmmc_get_cid(bool isNand, u32 *info)
+{
+    (void)isNand;
+    memset(info, 0, 0x10);
+}
+
+static void fail(const char *message, const char *argument)
+{
+    fprintf(stderr, "firmprep: ");
+    fprintf(stderr, message, argument);
+    fputc('\n', stderr);
+    exit(1);
+}
+
+static u32 readFile(const char *path, u8 *buffer, u32 maxSize)
+{
+    FILE *file = fopen(path, "rb");
+    if(file == NULL) fail("can't open %s", path);
+
+    u32 size = (u32)fread(buffer, 1, maxSize, file);
+    bool tooBig = fgetc(file) != EOF;
+    fclose(file);
+
+    if(tooBig) fail("%s is too big", path);
+
+    return size;
+}
+
+static u32 read32(const u8 *src)
+{
+    return src[0] | (src[1] << 8) | (src[2] << 16) | ((u32)src[3] << 24);
+}
+
+//Reads "slot0xNNKeyX=...", "slot0xNNKeyY=..." and "slot0xNNKeyN=..." lines (aes_keys.txt format)
+static void loadKeys(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if(file == NULL) fail("can't open %s", path);
+
+    char line[128];
+    u32 loaded = 0;
+
+    while(fgets(line, sizeof(line), file) != NULL)
+    {
+        unsigned int keyslot;
+        char keyType;
+        char hex[33];
+        u8 key[AES_BLOCK_SIZE];
+
+        if(sscanf(line, "slot0x%2xKey%c=%32[0-9A-Fa-f]", &keyslot, &keyType, hex) != 3 || strlen(hex) != 32) continue;
+
+        for(u32 i = 0; i < sizeof(key); i++)
+        {
+            char byte[3] = {hex[i * 2], hex[i * 2 + 1], 0};
+            key[i] = (u8)strtoul(byte, NULL, 16);
+        }
+
+        switch(toupper((unsigned char)keyType))
+        {
+            case 'X': aes_setkey((u8)keyslot, key, AES_KEYX, AES_INPUT_BE | AES_INPUT_NORMAL); break;
+            case 'Y': aes_setkey((u8)keyslot, key, AES_KEYY, AES_INPUT_BE | AES_INPUT_NORMAL); break;
+            case 'N': aes_setkey((u8)keyslot, key, AES_KEYNORMAL, AES_INPUT_BE | AES_INPUT_NORMAL); break;
+            default: continue;
+        }
+
+        loaded++;
+    }
+
+    fclose(file);
+
+    if(loaded == 0) fail("no keys found in %s", path);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: firmprep -k aes_keys.txt [-c o3ds|n3ds] <NUS content> <cetk> <output>\n\n"
+                    "Decrypts a FIRM title content (e.g. 00000000 of 0004013800000002) for /puma/firmware.bin.\n"
+                    "The key file needs slot0x2CKeyX and slot0x3DKeyX. The output is checked like the payload\n"
+                    "does at boot: it must be a FIRM whose ARM9 section is loaded where the chosen console expects it.\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    const char *keysPath = NULL,
+               *console = NULL;
+    int i;
+
+    for(i = 1; i < argc && argv[i][0] == '-'; i++)
+    {
+        if(strcmp(argv[i], "-k") == 0 && i + 1 < argc) keysPath = argv[++i];
+        else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc) console = argv[++i];
+        else usage();
+    }
+
+    if(keysPath == NULL || argc - i != 3 || (console != NULL && strcmp(console, "o3ds") != 0 && strcmp(console, "n3ds") != 0)) usage();
+
+    static u8 firm[MAX_FIRM_SIZE],
+              cetk[CETK_SIZE];
+
+    loadKeys(keysPath);
+
+    u32 firmSize = readFile(argv[i], firm, sizeof(firm));
+
+    if(memcmp(firm, "FIRM", 4) == 0) printf("%s is already decrypted\n", argv[i]);
+    else
+    {
+        if(readFile(argv[i + 1], cetk, sizeof(cetk)) != sizeof(cetk)) fail("%s is not a cetk", argv[i + 1]);
+        if(firmSize < 0x200 || memcmp(firm + 0x100, "NCCH", 4) == 0) fail("%s is not an encrypted NUS content", argv[i]);
+
+        decryptNusFirm(cetk, firm, firmSize & ~(AES_BLOCK_SIZE - 1));
+
+        if(memcmp(firm, "FIRM", 4) != 0) fail("decrypting %s failed, check the keys", argv[i]);
+    }
+
+    //Work out the FIRM size and check the section hashes
+    u32 size = 0x200;
+
+    for(u32 section = 0; section < 4; section++)
+    {
+        const u8 *header = firm + 0x40 + section * 0x30;
+        u32 offset = read32(header),
+            sectionSize = read32(header + 8);
+        u8 hash[SHA_256_HASH_SIZE];
+
+        if(sectionSize == 0) continue;
+        if(offset + sectionSize > firmSize || offset + sectionSize < offset) fail("%s has a truncated FIRM section", argv[i]);
+
+        sha(hash, firm + offset, sectionSize, SHA_256_MODE);
+        if(memcmp(hash, header + 0x10, sizeof(hash)) != 0) fail("%s has a corrupted FIRM section", argv[i]);
+
+        if(offset + sectionSize > size) size = offset + sectionSize;
+    }
+
+    //Same check as loadFirm, from the ARM9 section address
+    u32 arm9Address = read32(firm + 0x40 + 3 * 0x30) != 0 ? read32(firm + 0x44 + 3 * 0x30) : read32(firm + 0x44 + 2 * 0x30);
+    const char *firmConsole = arm9Address == 0x8006000 ? "n3ds" : (arm9Address == 0x8006800 ? "o3ds" : NULL);
+
+    if(firmConsole == NULL) fail("%s is not a FIRM for either console", argv[i]);
+    if(console != NULL && strcmp(console, firmConsole) != 0) fail("%s is not designed for this console", argv[i]);
+
+    FILE *out = fopen(argv[i + 2], "wb");
+    if(out == NULL || fwrite(firm, 1, size, out) != size || fclose(out) != 0) fail("can't write %s", argv[i + 2]);
+
+    printf("Wrote %s (%s FIRM, 0x%X bytes)\n", argv[i + 2], firmConsole, size);
+
+    return 0;
+}
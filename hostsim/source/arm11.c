@@ -0,0 +1,65 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   Model of the ARM11 side of screen.c: a function handed to the ARM11 runs on its own thread,
+*   which waitForArm11Function joins like the ARM9 waits for the stub to get control back
+*/
+
+#include <pthread.h>
+#include <sched.h>
+#include "hostsim.h"
+#include "screen.h"
+
+static pthread_t arm11Thread;
+static void (*arm11Function)(void);
+static bool isArm11Busy = false;
+
+static void *arm11Main(void *argument)
+{
+    (void)argument;
+    arm11Function();
+
+    return NULL;
+}
+
+void startArm11Function(void (*func)())
+{
+    if(isArm11Busy) fail("the ARM11 got a function while it was still running one");
+
+    arm11Function = (void (*)(void))func;
+    isArm11Busy = true;
+    if(pthread_create(&arm11Thread, NULL, arm11Main, NULL) != 0) fail("can't start the ARM11 thread");
+}
+
+void waitForArm11Function(void)
+{
+    if(!isArm11Busy) return;
+
+    pthread_join(arm11Thread, NULL);
+    isArm11Busy = false;
+}
+
+void arm11ModelSpin(void)
+{
+    sched_yield();
+}
@@ -0,0 +1,590 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   Checks of the payload code against the models, "hostsim check" runs them all
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "hostsim.h"
+#include "tmio.h"
+#include "crypto.h"
+#include "softcrypto.h"
+#include "worker.h"
+#include "loaderipc.h"
+#include "faults.h"
+#include "image.h"
+#include "fs.h"
+#include "exceptions.h"
+#include "sessions.h"
+#include "fatfs/sdmmc/sdmmc.h"
+
+#define SD_SECTORS   0x8000 //16MB
+#define NAND_SECTORS 0x4000 //8MB
+
+#define O3DS_CTRNAND_FAT_START 0x5CAE5 //As set by ctrNandInit
+
+extern u32 emuOffset;
+extern FirmwareSource firmSource;
+
+void arm9_memcpy(void *dest, const void *src, u32 size); //memory.c's memcpy, renamed by the Makefile
+
+#define CHECK(condition) check(condition, #condition, __LINE__)
+
+static u32 checks,
+           failures;
+
+static Card sdCard,
+            nandCard;
+
+static void check(bool condition, const char *text, int line)
+{
+    checks++;
+    if(condition) return;
+
+    failures++;
+    printf("  FAILED (checks.c:%d): %s\n", line, text);
+}
+
+static u8 patternByte(u32 seed, u32 sector, u32 offset)
+{
+    u32 x = seed ^ (sector * 0x9E3779B1u) ^ (offset * 0x85EBCA77u);
+    x ^= x >> 15;
+    x *= 0x2C1B3C6Du;
+    x ^= x >> 12;
+
+    return (u8)x;
+}
+
+static void fillPattern(u8 *data, u32 seed, u32 firstSector, u32 sectors)
+{
+    for(u32 sector = 0; sector < sectors; sector++)
+        for(u32 offset = 0; offset < 0x200; offset++)
+            data[sector * 0x200 + offset] = patternByte(seed, firstSector + sector, offset);
+}
+
+static bool matchesPattern(const u8 *data, u32 seed, u32 firstSector, u32 sectors)
+{
+    for(u32 sector = 0; sector < sectors; sector++)
+        for(u32 offset = 0; offset < 0x200; offset++)
+            if(data[sector * 0x200 + offset] != patternByte(seed, firstSector + sector, offset)) return false;
+
+    return true;
+}
+
+//Fresh cards with known contents behind both ports, then the payload's init sequence
+static void insertCards(void)
+{
+    static u8 *sdData,
+              *nandData;
+
+    if(sdData == NULL)
+    {
+        sdData = malloc(SD_SECTORS * 0x200);
+        nandData = malloc(NAND_SECTORS * 0x200);
+        if(sdData == NULL || nandData == NULL) fail("out of memory");
+    }
+
+    fillPattern(sdData, 1, 0, SD_SECTORS);
+    fillPattern(nandData, 2, 0, NAND_SECTORS);
+
+    cardInit(&sdCard, sdData, SD_SECTORS, false);
+    cardInit(&nandCard, nandData, NAND_SECTORS, true);
+    tmioInsert(TMIO_PORT_SD, &sdCard);
+    tmioInsert(TMIO_PORT_NAND, &nandCard);
+
+    sdmmc_sdcard_init();
+}
+
+static void checkInit(void)
+{
+    u32 done = 1;
+
+    //Nothing has been submitted yet: there is nothing to poll or wait for
+    CHECK(sdmmc_transfer_poll(&done) && done == 0 && sdmmc_transfer_wait() == 0);
+
+    insertCards();
+
+    CHECK(getMMCDevice(1)->total_size == SD_SECTORS);
+    CHECK(getMMCDevice(0)->total_size == NAND_SECTORS);
+    CHECK(sdCard.selected && nandCard.selected);
+    CHECK(sdCard.stats.strayAcmds == 0 && sdCard.stats.timeouts == 0 && nandCard.stats.timeouts == 0);
+    CHECK(tmioSelectedPort() == TMIO_PORT_SD);
+}
+
+static void checkSyncTransfers(void)
+{
+    static u8 buffer[64 * 0x200];
+
+    insertCards();
+
+    CHECK(sdmmc_sdcard_readsectors(10, 64, buffer) == 0 && matchesPattern(buffer, 1, 10, 64));
+    CHECK(sdmmc_nand_readsectors(NAND_SECTORS - 64, 64, buffer) == 0 && matchesPattern(buffer, 2, NAND_SECTORS - 64, 64));
+
+    fillPattern(buffer, 3, 0, 64);
+    CHECK(sdmmc_sdcard_writesectors(500, 64, buffer) == 0 && matchesPattern(sdCard.data + 500 * 0x200, 3, 0, 64));
+    CHECK(sdmmc_sdcard_writesectors(700, 1, buffer) == 0 && matchesPattern(sdCard.data + 700 * 0x200, 3, 0, 1));
+    CHECK(matchesPattern(sdCard.data + 564 * 0x200, 1, 564, 136) && matchesPattern(sdCard.data + 701 * 0x200, 1, 701, 1));
+
+    memset(buffer, 0, sizeof(buffer));
+    CHECK(sdmmc_sdcard_readsectors(500, 64, buffer) == 0 && matchesPattern(buffer, 3, 0, 64));
+}
+
+static void checkAsyncReads(void)
+{
+    static u8 buffer[128 * 0x200],
+              other[16 * 0x200];
+    u32 done,
+        lastDone = 0,
+        earlyReturns = 0;
+    bool ordered = true,
+         ready = true;
+
+    insertCards();
+
+    //The card takes a while to send the first sector, the first poll must not wait for it
+    sdmmc_sdcard_readsectors_submit(1000, 128, buffer);
+    CHECK(!sdmmc_transfer_poll(&done) && done == 0);
+
+    //Every sector reported as done is already in the buffer
+    while(!sdmmc_transfer_poll(&done))
+    {
+        earlyReturns++;
+        if(done < lastDone || done > 128) ordered = false;
+        else if(!matchesPattern(buffer, 1, 1000, done)) ready = false;
+        lastDone = done;
+    }
+
+    CHECK(ordered && ready);
+    CHECK(done == 128);
+    CHECK(earlyReturns > 0);
+    CHECK(sdmmc_transfer_wait() == 0 && matchesPattern(buffer, 1, 1000, 128));
+
+    //Waiting on a transfer which is under way finishes it
+    memset(buffer, 0, sizeof(buffer));
+    sdmmc_nand_readsectors_submit(20, 128, buffer);
+    sdmmc_transfer_poll(NULL);
+    CHECK(sdmmc_transfer_wait() == 0 && matchesPattern(buffer, 2, 20, 128));
+    CHECK(tmioSelectedPort() == TMIO_PORT_SD);
+
+    //A new transfer finishes the pending one first, whatever the device
+    memset(buffer, 0, sizeof(buffer));
+    sdmmc_sdcard_readsectors_submit(3000, 128, buffer);
+    sdmmc_nand_readsectors_submit(40, 16, other);
+    CHECK(matchesPattern(buffer, 1, 3000, 128));
+    CHECK(sdmmc_transfer_wait() == 0 && matchesPattern(other, 2, 40, 16));
+
+    //Synchronous calls do too
+    memset(buffer, 0, sizeof(buffer));
+    sdmmc_nand_readsectors_submit(60, 128, buffer);
+    CHECK(sdmmc_sdcard_readsectors(50, 16, other) == 0 && matchesPattern(other, 1, 50, 16));
+    CHECK(matchesPattern(buffer, 2, 60, 128));
+
+    //Errors come out of the wait, and the next transfer isn't affected
+    sdmmc_sdcard_readsectors_submit(SD_SECTORS - 2, 4, buffer);
+    while(!sdmmc_transfer_poll(&done));
+    CHECK(sdmmc_transfer_wait() != 0);
+    CHECK(sdmmc_sdcard_readsectors(SD_SECTORS - 4, 4, buffer) == 0 && matchesPattern(buffer, 1, SD_SECTORS - 4, 4));
+}
+
+static void checkHighSpeed(void)
+{
+    static u8 buffer[64 * 0x200];
+
+    //A card which supports high speed gets HCLK/2
+    insertCards();
+    CHECK(sdCard.inHighSpeed && tmioClockDivider() == 2);
+    CHECK(sdmmc_sdcard_readsectors(0, 64, buffer) == 0 && matchesPattern(buffer, 1, 0, 64) && sdCard.stats.crcErrors == 0);
+
+    //Without the switch command class (SD 1.0), CMD6 isn't even tried
+    insertCards();
+    sdCard.ccc &= ~0x400;
+    sdmmc_sdcard_init();
+    CHECK(!sdCard.inHighSpeed && tmioClockDivider() == 4 && sdCard.stats.timeouts == 0);
+    CHECK(sdmmc_sdcard_readsectors(0, 64, buffer) == 0 && matchesPattern(buffer, 1, 0, 64));
+
+    //Cards which know CMD6 but not high speed stay at HCLK/4
+    insertCards();
+    sdCard.highSpeed = false;
+    sdmmc_sdcard_init();
+    CHECK(!sdCard.inHighSpeed && tmioClockDivider() == 4 && sdCard.stats.timeouts == 0);
+    CHECK(sdmmc_sdcard_readsectors(0, 64, buffer) == 0 && matchesPattern(buffer, 1, 0, 64) && sdCard.stats.crcErrors == 0);
+
+    //Standard capacity cards take byte addresses, and have an older CSD
+    insertCards();
+    sdCard.isSdhc = false;
+    sdmmc_sdcard_init();
+    CHECK(!getMMCDevice(1)->isSDHC && getMMCDevice(1)->total_size == SD_SECTORS);
+    CHECK(sdmmc_sdcard_readsectors(3000, 64, buffer) == 0 && matchesPattern(buffer, 1, 3000, 64));
+
+    //A CRC error at high speed drops the clock to HCLK/4, and the synchronous functions retry
+    insertCards();
+    sdCard.highSpeedCrcErrors = 1;
+    sdCard.crcErrorDelay = 8;
+    CHECK(sdmmc_sdcard_readsectors(200, 64, buffer) == 0 && matchesPattern(buffer, 1, 200, 64));
+    CHECK(sdCard.stats.crcErrors == 1 && tmioClockDivider() == 4);
+
+    insertCards();
+    sdCard.highSpeedCrcErrors = 1;
+    sdCard.crcErrorDelay = 8;
+    fillPattern(buffer, 5, 0, 64);
+    CHECK(sdmmc_sdcard_writesectors(300, 64, buffer) == 0 && matchesPattern(sdCard.data + 300 * 0x200, 5, 0, 64));
+    CHECK(sdCard.stats.crcErrors == 1 && tmioClockDivider() == 4);
+
+    //It stays there, even if the card would keep failing at high speed
+    sdCard.highSpeedCrcErrors = 1000;
+    CHECK(sdmmc_sdcard_readsectors(200, 64, buffer) == 0 && sdCard.stats.crcErrors == 1);
+}
+
+//ACMD23 is only a hint to pre-erase the blocks of a multi-block write, it mustn't go out on its own or fail the write
+static void checkPreErase(void)
+{
+    static u8 buffer[64 * 0x200];
+
+    insertCards();
+    fillPattern(buffer, 6, 0, 64);
+    CHECK(sdmmc_sdcard_writesectors(400, 64, buffer) == 0 && sdCard.stats.preErasedBlocks == 64);
+
+    //If the card misses the CMD55, the next command isn't an ACMD to it
+    insertCards();
+    sdCard.failedCmd55s = 1;
+    CHECK(sdmmc_sdcard_writesectors(400, 64, buffer) == 0 && matchesPattern(sdCard.data + 400 * 0x200, 6, 0, 64));
+    CHECK(sdCard.stats.strayAcmds == 0 && sdCard.stats.preErasedBlocks == 0);
+
+    insertCards();
+    sdCard.noPreErase = true;
+    CHECK(sdmmc_sdcard_writesectors(400, 64, buffer) == 0 && matchesPattern(sdCard.data + 400 * 0x200, 6, 0, 64));
+}
+
+//EmuNAND reads are decrypted as they come in, a CRC error mustn't leave half-decrypted data behind
+static void checkEmuNandRetry(void)
+{
+    static u8 buffer[64 * 0x200];
+    static const u8 key[AES_BLOCK_SIZE] = {0x10, 0x32, 0x54, 0x76, 0x98, 0xBA, 0xDC, 0xFE, 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF};
+    const u32 emuSectors = 0x60000, //192MB
+              firstSector = 0x800 + O3DS_CTRNAND_FAT_START + 100;
+
+    //Big enough for an EmuNAND at 0x800, only the pages which are written get allocated
+    u8 *emuData = calloc(emuSectors, 0x200);
+    if(emuData == NULL) fail("out of memory");
+
+    insertCards();
+    cardInit(&sdCard, emuData, emuSectors, false);
+    fillPattern(emuData + firstSector * 0x200, 4, 0, 64);
+    sdmmc_sdcard_init();
+
+    ctrNandInit();
+    aes_setkey(0x04, key, AES_KEYNORMAL, AES_INPUT_BE | AES_INPUT_NORMAL);
+    firmSource = FIRMWARE_EMUNAND;
+    emuOffset = 0x800;
+
+    //CTR mode: decrypting what was decrypted gives the original back
+    CHECK(ctrNandRead(100, 64, buffer) == 0 && !matchesPattern(buffer, 4, 0, 64));
+    memcpy(emuData + firstSector * 0x200, buffer, sizeof(buffer));
+    CHECK(ctrNandRead(100, 64, buffer) == 0 && matchesPattern(buffer, 4, 0, 64));
+
+    memset(buffer, 0, sizeof(buffer));
+    sdCard.highSpeedCrcErrors = 1;
+    sdCard.crcErrorDelay = 16;
+    CHECK(ctrNandRead(100, 64, buffer) == 0 && matchesPattern(buffer, 4, 0, 64));
+    CHECK(sdCard.stats.crcErrors == 1 && tmioClockDivider() == 4);
+
+    firmSource = FIRMWARE_SYSNAND;
+    emuOffset = 0;
+    free(emuData);
+}
+
+//The ARM9 side of the queue against the worker loop running on a thread
+static void checkWorker(void)
+{
+    static const u8 lz[] = {0x10, 0x0C, 0x00, 0x00, 0x08, 'A', 'B', 'C', 'D', 0x50, 0x03}; //"ABCD", then 8 bytes from 4 back
+    static u8 source[0x10000],
+              copies[64][0x400],
+              dest[0x400],
+              unpacked[12];
+    static u32 values[20000],
+               results[20000];
+    u32 jobs[64],
+        job = 0;
+
+    fillPattern(source, 7, 0, sizeof(source) / 0x200);
+    startArm11Worker();
+
+    //More jobs than slots without waiting in between: the queue wraps around and nothing gets lost
+    for(u32 i = 0; i < 64; i++) jobs[i] = arm11WorkerCopy(copies[i], source + i * 0x100, sizeof(copies[i]));
+    arm11WorkerWait(jobs[63]);
+
+    bool copied = jobs[63] - jobs[0] == 63;
+    for(u32 i = 0; i < 64; i++) copied = copied && memcmp(copies[i], source + i * 0x100, sizeof(copies[i])) == 0;
+    CHECK(copied);
+
+    //Jobs run in order, the last copy to a buffer wins
+    for(u32 i = 0; i < 20; i++) job = arm11WorkerCopy(dest, source + i * sizeof(dest), sizeof(dest));
+    arm11WorkerWait(job);
+    CHECK(memcmp(dest, source + 19 * sizeof(dest), sizeof(dest)) == 0);
+
+    //Results can be picked up in any order, as long as the slot hasn't been reused
+    u32 search = arm11WorkerSearch(source, source + 0x8123, sizeof(source), 16),
+        decompress = arm11WorkerDecompress(unpacked, lz);
+    CHECK((uintptr_t)arm11WorkerWait(decompress) == sizeof(unpacked) && memcmp(unpacked, "ABCDABCDABCD", sizeof(unpacked)) == 0);
+    CHECK(arm11WorkerWait(search) == source + 0x8123);
+
+    //Lots of tiny jobs, where the ARM9 keeps finding the queue full or empty
+    for(u32 i = 0; i < 20000; i++)
+    {
+        values[i] = i * 0x9E3779B1u;
+        job = arm11WorkerCopy(&results[i], &values[i], sizeof(values[i]));
+    }
+    arm11WorkerWait(job);
+    CHECK(memcmp(results, values, sizeof(values)) == 0);
+
+    //Once stopped, and on firmlaunches, jobs run right away on the ARM9
+    stopArm11Worker();
+    arm11WorkerCopy(dest, source, sizeof(dest));
+    CHECK(memcmp(dest, source, sizeof(dest)) == 0);
+
+    isFirmlaunch = true;
+    startArm11Worker();
+    arm11WorkerCopy(dest, source + sizeof(dest), sizeof(dest));
+    CHECK(memcmp(dest, source + sizeof(dest), sizeof(dest)) == 0);
+    stopArm11Worker();
+    isFirmlaunch = false;
+}
+
+//A few passes over a sector, about as long as it takes to come in at high speed
+static u32 sectorJob(const u8 *sector)
+{
+    u32 sum = 0;
+
+    for(u32 pass = 0; pass < 32; pass++)
+        for(u32 i = 0; i < 0x200; i++) sum = sum * 31 + sector[i];
+
+    return sum;
+}
+
+//How much of a per-sector job the async API hides behind the transfer
+static void reportOverlap(void)
+{
+    static u8 buffer[256 * 0x200];
+    volatile u32 sink = 0;
+
+    insertCards();
+
+    u64 start = hostNs();
+    sdmmc_sdcard_readsectors(0, 256, buffer);
+    for(u32 sector = 0; sector < 256; sector++) sink += sectorJob(buffer + sector * 0x200);
+    u64 sequential = hostNs() - start;
+
+    start = hostNs();
+    sdmmc_sdcard_readsectors_submit(0, 256, buffer);
+    for(u32 sector = 0, done = 0; sector < 256;)
+    {
+        bool finished = sdmmc_transfer_poll(&done);
+
+        if(sector < done) sink += sectorJob(buffer + 0x200 * sector++);
+        else if(finished) break;
+    }
+    sdmmc_transfer_wait();
+    u64 overlapped = hostNs() - start;
+
+    printf("  256 sectors from SD then a job on each: %llu us, same jobs while they come in: %llu us\n",
+           (unsigned long long)sequential / 1000, (unsigned long long)overlapped / 1000);
+}
+
+//What handing half of a copy to the worker buys, with the ARM9 copying the other half meanwhile,
+//and what a job costs when the ARM9 waits for each one (best of a few runs)
+static void reportWorkerSpeedup(void)
+{
+    static u8 buffer[0x100];
+    u32 size = 0x800000;
+    u8 *source = malloc(2 * size),
+       *dest = malloc(2 * size);
+    u64 sequential = UINT64_MAX,
+        split = UINT64_MAX,
+        roundTrips = UINT64_MAX;
+
+    if(source == NULL || dest == NULL) fail("out of memory");
+    memset(source, 0x5A, 2 * size);
+    memset(dest, 0, 2 * size);
+
+    startArm11Worker();
+
+    for(u32 run = 0; run < 5; run++)
+    {
+        u64 start = hostNs();
+        arm9_memcpy(dest, source, 2 * size);
+        u64 time = hostNs() - start;
+        if(time < sequential) sequential = time;
+
+        start = hostNs();
+        u32 job = arm11WorkerCopy(dest, source, size);
+        arm9_memcpy(dest + size, source + size, size);
+        arm11WorkerWait(job);
+        time = hostNs() - start;
+        if(time < split) split = time;
+
+        start = hostNs();
+        for(u32 i = 0; i < 1000; i++) arm11WorkerWait(arm11WorkerCopy(buffer, source, sizeof(buffer)));
+        time = hostNs() - start;
+        if(time < roundTrips) roundTrips = time;
+    }
+
+    stopArm11Worker();
+
+    printf("  16MB copy on the ARM9: %llu us, half of it on the worker: %llu us, 256-byte job round trip: %llu ns\n",
+           (unsigned long long)sequential / 1000, (unsigned long long)split / 1000, (unsigned long long)roundTrips / 1000);
+    if(sysconf(_SC_NPROCESSORS_ONLN) < 2) printf("  (one host CPU: the worker can't run alongside the ARM9 here)\n");
+
+    free(source);
+    free(dest);
+}
+
+//Faults with deep stacks on the ARM9 and two ARM11 cores, then the payload writing every slot out after the reboot
+static void checkExceptionDumps(void)
+{
+    static u8 nand[0x1000 * 0x200],
+              file[DUMP_SLOT_SIZE];
+    const ExceptionDumpHeader *arm9Dump = (const ExceptionDumpHeader *)DUMP_SLOTS,
+                              *core1Dump = (const ExceptionDumpHeader *)(DUMP_SLOTS + DUMP_SLOT_SIZE),
+                              *core2Dump = (const ExceptionDumpHeader *)(DUMP_SLOTS + 2 * DUMP_SLOT_SIZE);
+    u8 *stack = (u8 *)(uintptr_t)FAULT_STACK;
+    u32 arm9Stack = sizeof(ExceptionDumpHeader) + 4 * 17 + 48,
+        arm11Stack = sizeof(ExceptionDumpHeader) + 4 * 23 + 48;
+
+    mapFaultMemory();
+    memset(DUMP_SLOTS, 0, DUMP_SLOT_COUNT * DUMP_SLOT_SIZE);
+    fillPattern(stack, 9, 0, FAULT_STACK_SIZE / 0x200);
+
+    //The whole 16KB window from a page-aligned SP, then what's left of it from the middle of a page
+    faultArm9(FAULT_STACK + 0x80000);
+    CHECK(arm9Dump->magic[0] == 0xDEADC0DE && arm9Dump->processor == 9 && arm9Dump->codeDumpSize == 48);
+    CHECK(arm9Dump->stackDumpSize == 0x4000 && arm9Dump->totalSize == arm9Stack + 0x4000);
+    CHECK(memcmp((const u8 *)arm9Dump + arm9Stack, stack + 0x80000, 0x4000) == 0);
+
+    faultArm11(1, FAULT_STACK + 0x40800);
+    CHECK(core1Dump->magic[0] == 0xDEADC0DE && core1Dump->processor == 11 && core1Dump->core == 1);
+    CHECK(core1Dump->stackDumpSize == 0x3800 && core1Dump->totalSize == arm11Stack + 0x3800);
+    CHECK(memcmp((const u8 *)core1Dump + arm11Stack, stack + 0x40800, 0x3800) == 0);
+
+    //Up to the end of what can be read
+    faultArm11(2, FAULT_STACK + FAULT_STACK_SIZE - 0x1000);
+    CHECK(core2Dump->core == 2 && core2Dump->stackDumpSize == 0x1000);
+
+    u32 sectors = 0x800000;
+    u8 *image = createFatImage(sectors, 64);
+
+    cardInit(&nandCard, nand, sizeof(nand) / 0x200, true);
+    tmioInsert(TMIO_PORT_NAND, &nandCard);
+    cardInit(&sdCard, image, sectors, false);
+    tmioInsert(TMIO_PORT_SD, &sdCard);
+    mountFs();
+
+    detectAndProcessExceptionDumps(true);
+    CHECK(fileRead(file, "/puma/dumps/arm9/crash_dump_00000000.dmp", sizeof(file)) == arm9Stack + 0x4000 &&
+          memcmp(file + arm9Stack, stack + 0x80000, 0x4000) == 0);
+    CHECK(fileRead(NULL, "/puma/dumps/arm11/crash_dump_00000000.dmp", 0) == arm11Stack + 0x3800);
+    CHECK(fileRead(NULL, "/puma/dumps/arm11/crash_dump_00000001.dmp", 0) == arm11Stack + 0x1000);
+    CHECK(arm9Dump->magic[0] == 0 && core1Dump->magic[0] == 0 && core2Dump->magic[0] == 0);
+
+    //A dump which doesn't make it to the card is reported
+    sdCard.failedWrites = 0xFFFFFFFF;
+    CHECK(!fileWrite(file, "/puma/dumps/arm9/crash_dump_00000001.dmp", arm9Stack + 0x4000));
+    sdCard.failedWrites = 0;
+
+    unmapImage(image, sectors);
+}
+
+//The loader's session list, then its service loop with several clients on the kernel model
+static void checkLoaderSessions(void)
+{
+    session_list_t list;
+
+    sessions_init(&list, 3);
+    CHECK(sessions_add(&list, 10) && sessions_add(&list, 11) && sessions_add(&list, 12) && !sessions_add(&list, 13));
+    CHECK(sessions_find(&list, 11) == SESSION_FIRST + 1 && sessions_find(&list, 13) == -1);
+
+    //The session served goes behind the others, a closed one leaves them in order
+    sessions_served(&list, SESSION_FIRST);
+    CHECK(list.handles[SESSION_FIRST] == 11 && list.handles[SESSION_FIRST + 1] == 12 && list.handles[SESSION_FIRST + 2] == 10);
+    sessions_remove(&list, SESSION_FIRST);
+    CHECK(list.count == SESSION_FIRST + 2 && list.handles[SESSION_FIRST] == 12 && list.handles[SESSION_FIRST + 1] == 10);
+    CHECK(sessions_add(&list, 13) && list.handles[SESSION_FIRST + 2] == 13);
+
+    //Four clients which always have a request waiting: each one gets a turn before any gets a second one,
+    //and the fifth is refused
+    LoaderClient busy[5] = {
+        {.name = "a", .serviceUs = 100}, {.name = "b", .serviceUs = 100}, {.name = "c", .serviceUs = 100},
+        {.name = "d", .serviceUs = 100}, {.name = "e", .serviceUs = 100}
+    };
+    LoaderRun run = {busy, 5, MAX_SESSIONS, true, 100000, 0};
+
+    simulateLoader(&run);
+    bool fair = busy[4].rejected && busy[4].served == 0;
+    for(u32 i = 0; i < 4; i++) fair = fair && !busy[i].rejected && busy[i].served >= 249 && busy[i].maxWaitUs <= 400;
+    CHECK(fair);
+
+    //A client that leaves makes room for a later one, and srv's notification stops the loop once the rest close
+    LoaderClient leaving[5] = {
+        {.name = "pm", .serviceUs = 40000, .thinkUs = 1000},
+        {.name = "short", .serviceUs = 30, .requests = 3},
+        {.name = "c", .serviceUs = 30, .thinkUs = 100}, {.name = "d", .serviceUs = 30, .thinkUs = 100},
+        {.name = "late", .connectUs = 200000, .serviceUs = 30, .thinkUs = 100}
+    };
+    run = (LoaderRun){leaving, 5, MAX_SESSIONS, true, 1000000, 0};
+
+    simulateLoader(&run);
+    CHECK(leaving[1].served == 3 && !leaving[4].rejected && leaving[4].served > 0);
+    CHECK(leaving[0].served > 20 && leaving[0].maxWaitUs <= 40000 + 3 * 30);
+    CHECK(run.endUs >= run.durationUs && run.endUs <= run.durationUs + 40000);
+}
+
+static void runGroup(const char *name, void (*function)(void))
+{
+    u32 previousFailures = failures;
+
+    printf("%s\n", name);
+    function();
+    if(failures == previousFailures) printf("  ok\n");
+}
+
+int runChecks(void)
+{
+    runGroup("sdmmc: card init", checkInit);
+    runGroup("sdmmc: synchronous transfers", checkSyncTransfers);
+    runGroup("sdmmc: submit/poll/wait", checkAsyncReads);
+    runGroup("sdmmc: high speed negotiation and CRC fallback", checkHighSpeed);
+    runGroup("sdmmc: pre-erase hints", checkPreErase);
+    runGroup("crypto: EmuNAND reads with a CRC error", checkEmuNandRetry);
+    reportOverlap();
+    runGroup("worker: ARM11 job queue", checkWorker);
+    reportWorkerSpeedup();
+    runGroup("exceptions: dump slots", checkExceptionDumps);
+    runGroup("loader: sessions and service loop", checkLoaderSessions);
+
+    printf("%u checks, %u failed\n", checks, failures);
+
+    return failures == 0 ? 0 : 1;
+}
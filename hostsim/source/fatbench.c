@@ -0,0 +1,146 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   hostsim fatbench: times fileWrite (fs.c) on a FAT volume of the SD card model, with the sizes the payload writes,
+*   against the same files written by FatFs alone
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "hostsim.h"
+#include "image.h"
+#include "tmio.h"
+#include "fs.h"
+#include "fatfs/ff.h"
+
+#define FILES_PER_SIZE 8
+#define MAX_FILE_SIZE  0x100000
+
+typedef bool (*WriteFunction)(const void *buffer, const char *path, u32 size);
+
+static Card sdCard,
+            nandCard;
+
+//The plainest FatFs write, for reference: fileWrite adds the folder creation, the truncation and the error checks
+static bool fatFsWrite(const void *buffer, const char *path, u32 size)
+{
+    FIL file;
+    unsigned int written = 0;
+
+    if(f_open(&file, path, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) return false;
+    f_write(&file, buffer, size, &written);
+    f_close(&file);
+
+    return written == size;
+}
+
+static void runWrites(const char *name, WriteFunction write, const char *folder, u32 size, const u8 *data)
+{
+    static u8 readBack[MAX_FILE_SIZE];
+    CardStats before = sdCard.stats;
+    char path[64];
+
+    f_mkdir(folder);
+
+    u64 start = hostNs();
+    for(u32 i = 0; i < FILES_PER_SIZE; i++)
+    {
+        snprintf(path, sizeof(path), "%s/%08X.bin", folder, i);
+        if(!write(data + i, path, size)) fail("writing %s failed", path);
+    }
+    u64 time = hostNs() - start;
+
+    CardStats after = sdCard.stats;
+
+    for(u32 i = 0; i < FILES_PER_SIZE; i++)
+    {
+        snprintf(path, sizeof(path), "%s/%08X.bin", folder, i);
+        if(fileRead(readBack, path, sizeof(readBack)) != size || memcmp(readBack, data + i, size) != 0) fail("%s doesn't read back", path);
+    }
+
+    printf("  %-10s %9.3f %9.3f %9.1f %9.1f %9.1f %9.1f\n", name,
+           (double)time / FILES_PER_SIZE / 1000000, (double)(after.busNs - before.busNs) / FILES_PER_SIZE / 1000000,
+           (double)(after.commands - before.commands) / FILES_PER_SIZE, (double)(after.writeCommands - before.writeCommands) / FILES_PER_SIZE,
+           (double)(after.blocksWritten - before.blocksWritten) / FILES_PER_SIZE, (double)(after.readCommands - before.readCommands) / FILES_PER_SIZE);
+}
+
+int runFatBench(const char *imagePath)
+{
+    static const struct
+    {
+        const char *name;
+        u32 size;
+    } workloads[] = {
+        {"config.bin", 0x10},
+        {"exception dump", 0xC00},
+        {"dump with a 16KB stack", 0x40C4},
+        {"iotrace.bin", 0x2010},
+        {"64KB file", 0x10000},
+        {"1MB file", MAX_FILE_SIZE}
+    };
+    static u8 data[MAX_FILE_SIZE + FILES_PER_SIZE];
+    u32 sectors;
+    u8 *image;
+
+    if(imagePath != NULL) image = mapImage(imagePath, &sectors);
+    else
+    {
+        sectors = 0x800000;
+        image = createFatImage(sectors, 64);
+    }
+
+    for(u32 i = 0; i < sizeof(data); i++) data[i] = (u8)(i * 7 + (i >> 9));
+
+    //sdmmc_sdcard_init brings up the NAND too
+    static u8 nand[0x1000 * 0x200];
+    cardInit(&nandCard, nand, sizeof(nand) / 0x200, true);
+    tmioInsert(TMIO_PORT_NAND, &nandCard);
+    cardInit(&sdCard, image, sectors, false);
+    tmioInsert(TMIO_PORT_SD, &sdCard);
+    mountFs();
+
+    FATFS *fs;
+    DWORD freeClusters;
+    if(f_getfree("0:", &freeClusters, &fs) != FR_OK) fail("no FAT volume on the SD card");
+
+    printf("SD card: %u MB, %u KB clusters, model at HCLK/%u with %u us access and %u us programming per block\n",
+           sectors / 2048, fs->csize / 2, tmioClockDivider(), sdCard.accessNs / 1000, sdCard.programNs / 1000);
+    printf("Per file, averaged over %u files:\n", FILES_PER_SIZE);
+
+    for(u32 i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++)
+    {
+        char folder[32];
+
+        printf("%s (%u bytes)\n", workloads[i].name, workloads[i].size);
+        printf("  %-10s %9s %9s %9s %9s %9s %9s\n", "writer", "ms", "bus ms", "commands", "writes", "sectors", "reads");
+
+        snprintf(folder, sizeof(folder), "/fatfs%u", i);
+        runWrites("FatFs", fatFsWrite, folder, workloads[i].size, data);
+        snprintf(folder, sizeof(folder), "/fileWrite%u", i);
+        runWrites("fileWrite", fileWrite, folder, workloads[i].size, data);
+    }
+
+    unmapImage(image, sectors);
+
+    return 0;
+}
@@ -0,0 +1,185 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   Model of what the exception handlers run on, see faults.h
+*/
+
+//MAP_ANONYMOUS
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include "hostsim.h"
+#include "faults.h"
+
+#define ARM9_SLOTS  0x25000000
+#define ARM11_SLOTS 0xE5000000 //The kernel's mapping of FCRAM
+#define SLOTS_SIZE  0x80000    //The ring of dump slots and then some
+
+//The handlers' own stack, which they copy the registers from: below 4GB like everything they look at
+#define HANDLER_STACK      0x09000000
+#define HANDLER_STACK_SIZE 0x10000
+
+#define DUMP_SLOT_BUSY 0xDEADBABE
+#define DUMP_MAGIC     0xDEADC0DE
+
+//The handlers' entry points, renamed by the Makefile
+void arm9MainHandler(u32 *regs, u32 type);
+void arm11MainHandler(u32 *regs, u32 type, u32 cpuId);
+
+static ucontext_t caller,
+                  handler;
+static u32 faultSp,
+           faultCore;
+static bool onArm9;
+
+static void mapAt(u32 address, u32 size, int fd)
+{
+    void *data = mmap((void *)(uintptr_t)address, size, PROT_READ | PROT_WRITE, fd < 0 ? MAP_PRIVATE | MAP_ANONYMOUS : MAP_SHARED, fd, 0);
+
+    if(data != (void *)(uintptr_t)address) fail("can't map 0x%08X on the host", address);
+}
+
+void mapFaultMemory(void)
+{
+    static bool mapped;
+
+    if(mapped) return;
+
+    //Both processors' views of the slots are the same memory
+    FILE *slots = tmpfile();
+    if(slots == NULL || ftruncate(fileno(slots), SLOTS_SIZE) != 0) fail("can't create the dump slots");
+
+    mapAt(ARM9_SLOTS, SLOTS_SIZE, fileno(slots));
+    mapAt(ARM11_SLOTS, SLOTS_SIZE, fileno(slots));
+    mapAt(FAULT_STACK, FAULT_STACK_SIZE, -1);
+    mapAt(HANDLER_STACK, HANDLER_STACK_SIZE, -1);
+    mapped = true;
+}
+
+//ARM9: the MPU has a region for the slots and one for each stack, readable and writable
+u32 readMPUConfig(u32 *regionSettings)
+{
+    for(u32 i = 0; i < 8; i++) regionSettings[i] = 0;
+    regionSettings[0] = ARM9_SLOTS | (18 << 1) | 1;    //512KB
+    regionSettings[1] = FAULT_STACK | (19 << 1) | 1;   //1MB
+    regionSettings[2] = HANDLER_STACK | (15 << 1) | 1; //64KB
+
+    return 0x333;
+}
+
+bool i2cWriteRegister(u8 devId, u8 reg, u8 data)
+{
+    (void)devId;
+    (void)reg;
+    (void)data;
+    setcontext(&caller);
+    fail("can't get back from the ARM9 handler");
+}
+
+void flushCaches(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+//ARM11: only the slots and the stacks are mapped, not the kernel's current process
+bool cannotAccessVA(const void *address)
+{
+    uintptr_t addr = (uintptr_t)address;
+
+    return !((addr >= ARM11_SLOTS && addr < ARM11_SLOTS + SLOTS_SIZE) || (addr >= FAULT_STACK && addr < FAULT_STACK + FAULT_STACK_SIZE) ||
+             (addr >= HANDLER_STACK && addr < HANDLER_STACK + HANDLER_STACK_SIZE));
+}
+
+bool claimDumpSlot(void *slot)
+{
+    u32 value = __atomic_load_n((u32 *)slot, __ATOMIC_SEQ_CST);
+
+    do
+    {
+        if(value == DUMP_MAGIC || value == DUMP_SLOT_BUSY) return false;
+    }
+    while(!__atomic_compare_exchange_n((u32 *)slot, &value, DUMP_SLOT_BUSY, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+
+    return true;
+}
+
+void cleanInvalidateDCacheAndDMB(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void mcuReboot(void)
+{
+    setcontext(&caller);
+    fail("can't get back from the ARM11 handler");
+}
+
+//The faulting instruction sits in the stack region, so that there's code to dump
+static void runHandler(void)
+{
+    if(onArm9)
+    {
+        //Saved by the handlers: cpsr, pc, r8-r14, r0-r7
+        u32 regs[17] = {0x1F, FAULT_STACK + 0x100 + 8};
+
+        regs[7] = faultSp;
+        arm9MainHandler(regs, 3);
+    }
+    else
+    {
+        //Saved by the handlers: dfsr, ifsr, far, fpexc, fpinst, fpinst2, cpsr, pc, r8-r12, sp, lr, r0-r7
+        u32 regs[23] = {0, 0, 0, 0, 0, 0, 0x10, FAULT_STACK + 0x100 + 8};
+
+        regs[13] = faultSp;
+        arm11MainHandler(regs, 3, faultCore);
+    }
+}
+
+static void fault(void)
+{
+    mapFaultMemory();
+    if(getcontext(&handler) != 0) fail("getcontext failed");
+    handler.uc_stack.ss_sp = (void *)HANDLER_STACK;
+    handler.uc_stack.ss_size = HANDLER_STACK_SIZE;
+    handler.uc_link = &caller;
+    makecontext(&handler, runHandler, 0);
+    if(swapcontext(&caller, &handler) != 0) fail("swapcontext failed");
+}
+
+void faultArm9(u32 sp)
+{
+    onArm9 = true;
+    faultSp = sp;
+    fault();
+}
+
+void faultArm11(u32 core, u32 sp)
+{
+    onArm9 = false;
+    faultCore = core;
+    faultSp = sp;
+    fault();
+}
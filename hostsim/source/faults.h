@@ -0,0 +1,40 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   What the exception handlers (exceptions/arm9 and exceptions/arm11) run on: the dump slots at 0x25000000, seen at
+*   0xE5000000 by the ARM11, a stack, the MPU and MMU checks, and the reboot, which goes back to the caller
+*/
+
+#pragma once
+
+#include "types.h"
+
+#define FAULT_STACK      0x08000000 //Readable from here
+#define FAULT_STACK_SIZE 0x100000
+
+//Maps the memory above at its console addresses
+void mapFaultMemory(void);
+
+//A data abort with the stack pointer given, on the ARM9 or on an ARM11 core, up to the reboot that follows the dump
+void faultArm9(u32 sp);
+void faultArm11(u32 core, u32 sp);
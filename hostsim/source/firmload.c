@@ -0,0 +1,211 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   hostsim firmload: runs the storage and crypto stages of the boot (card init, FatFs mounts, EmuNAND location,
+*   CTRNAND decryption, loading and decrypting NATIVE_FIRM) on NAND and SD card images, and times each stage.
+*   That's as far as it goes: the config, the menus, patching and launching stay on the console, the crypto runs
+*   in software instead of on models of the AES and SHA engines, and the times are host times, not ARM9 cycles
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hostsim.h"
+#include "image.h"
+#include "tmio.h"
+#include "fs.h"
+#include "emunand.h"
+#include "crypto.h"
+#include "softcrypto.h"
+
+#define MAX_FIRM_SIZE 0x400000 //Same limit as loadFirm
+#define CETK_SIZE     0xA50
+
+static Card sdCard,
+            nandCard;
+static CardStats sdBefore,
+                 nandBefore;
+static u64 stageStart;
+
+//Reads "slot0xNNKeyX=...", "slot0xNNKeyY=..." and "slot0xNNKeyN=..." lines (aes_keys.txt format, like firmprep)
+static void loadKeys(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if(file == NULL) fail("can't open %s", path);
+
+    char line[128];
+    u32 loaded = 0;
+
+    while(fgets(line, sizeof(line), file) != NULL)
+    {
+        unsigned int keyslot;
+        char keyType;
+        char hex[33];
+        u8 key[AES_BLOCK_SIZE];
+
+        if(sscanf(line, "slot0x%2xKey%c=%32[0-9A-Fa-f]", &keyslot, &keyType, hex) != 3 || strlen(hex) != 32) continue;
+
+        for(u32 i = 0; i < sizeof(key); i++)
+        {
+            char byte[3] = {hex[i * 2], hex[i * 2 + 1], 0};
+            key[i] = (u8)strtoul(byte, NULL, 16);
+        }
+
+        switch(toupper((unsigned char)keyType))
+        {
+            case 'X': aes_setkey((u8)keyslot, key, AES_KEYX, AES_INPUT_BE | AES_INPUT_NORMAL); break;
+            case 'Y': aes_setkey((u8)keyslot, key, AES_KEYY, AES_INPUT_BE | AES_INPUT_NORMAL); break;
+            case 'N': aes_setkey((u8)keyslot, key, AES_KEYNORMAL, AES_INPUT_BE | AES_INPUT_NORMAL); break;
+            default: continue;
+        }
+
+        loaded++;
+    }
+
+    fclose(file);
+
+    if(loaded == 0) fail("no keys found in %s", path);
+}
+
+static void startStage(void)
+{
+    sdBefore = sdCard.stats;
+    nandBefore = nandCard.stats;
+    stageStart = hostNs();
+}
+
+static void endStage(const char *name)
+{
+    u64 time = hostNs() - stageStart;
+
+    printf("%-28s %9.3f %9u %9u %9.3f %9u %9u %9.3f\n", name, (double)time / 1000000,
+           sdCard.stats.commands - sdBefore.commands, sdCard.stats.blocksRead - sdBefore.blocksRead,
+           (double)(sdCard.stats.busNs - sdBefore.busNs) / 1000000,
+           nandCard.stats.commands - nandBefore.commands, nandCard.stats.blocksRead - nandBefore.blocksRead,
+           (double)(nandCard.stats.busNs - nandBefore.busNs) / 1000000);
+}
+
+static bool isFirm(const u8 *firm, u32 size)
+{
+    return size >= 0x200 && memcmp(firm, "FIRM", 4) == 0;
+}
+
+int runFirmLoad(const FirmLoadOptions *options)
+{
+    static u8 __attribute__((aligned(4))) firm[MAX_FIRM_SIZE],
+                                          cetk[CETK_SIZE];
+    static u32 cid[4];
+    u32 nandSectors,
+        sdSectors;
+
+    loadKeys(options->keysPath);
+    isN3DS = options->isN3DS;
+
+    u8 *nand = mapImage(options->nandPath, &nandSectors),
+       *sd = options->sdPath != NULL ? mapImage(options->sdPath, &sdSectors) : NULL;
+
+    //Without an SD card image, a blank FAT32 card: the payload doesn't boot without one
+    if(sd == NULL)
+    {
+        sdSectors = 0x800000;
+        sd = createFatImage(sdSectors, 64);
+    }
+
+    cardInit(&nandCard, nand, nandSectors, true);
+    cardInit(&sdCard, sd, sdSectors, false);
+
+    if(options->cidPath != NULL)
+    {
+        FILE *file = fopen(options->cidPath, "rb");
+        if(file == NULL || fread(cid, 1, sizeof(cid), file) != sizeof(cid)) fail("%s is not a 16-byte CID", options->cidPath);
+        fclose(file);
+
+        nandCard.cid = cid;
+    }
+
+    tmioInsert(TMIO_PORT_NAND, &nandCard);
+    tmioInsert(TMIO_PORT_SD, &sdCard);
+
+    printf("NAND: %u MB, SD card: %u MB, %s\n", nandSectors / 2048, sdSectors / 2048, isN3DS ? "N3DS" : "O3DS");
+    printf("%-28s %9s %9s %9s %9s %9s %9s %9s\n", "stage", "ms", "SD cmds", "SD blocks", "SD bus ms", "NAND cmds", "NAND blks", "NAND bus");
+
+    u64 bootStart = hostNs();
+
+    startStage();
+    mountFs();
+    endStage("card init, SD mount");
+
+    if(options->emuNand)
+    {
+        FirmwareSource nandType = FIRMWARE_EMUNAND;
+        u32 emuHeader;
+
+        startStage();
+        locateEmuNand(&emuHeader, &nandType);
+        endStage("locateEmuNand");
+
+        if(nandType == FIRMWARE_SYSNAND) fail("there's no EmuNAND on the SD card");
+        firmSource = nandType;
+    }
+
+    startStage();
+    u32 firmVersion = firmRead(firm, NATIVE_FIRM);
+    endStage("CTRNAND mount, firmRead");
+
+    if(firmVersion == 0xFFFFFFFF) fail("no NATIVE_FIRM content on CTRNAND, check the keys, the CID and the console");
+    if(memcmp(firm + 0x100, "NCCH", 4) != 0) fail("NATIVE_FIRM content %08X is not an NCCH", firmVersion);
+
+    startStage();
+    decryptExeFs(firm);
+    endStage("decryptExeFs");
+
+    if(!isFirm(firm, MAX_FIRM_SIZE)) fail("decrypting NATIVE_FIRM content %08X failed, check slot0x2CKeyX", firmVersion);
+
+    //The payload only loads this one with "Use SD FIRMs and modules", time it when it's there anyway
+    if(getFileSize("/puma/firmware.bin") != 0)
+    {
+        startStage();
+        u32 firmSize = fileReadVerified(firm, "/puma/firmware.bin", MAX_FIRM_SIZE);
+        endStage("SD firmware.bin read");
+
+        if(firmSize > 0 && !isFirm(firm, firmSize))
+        {
+            if(fileReadVerified(cetk, "/puma/cetk", sizeof(cetk)) != sizeof(cetk)) fail("/puma/firmware.bin is encrypted and there's no /puma/cetk");
+
+            startStage();
+            decryptNusFirm(cetk, firm, firmSize);
+            endStage("decryptNusFirm");
+
+            if(!isFirm(firm, firmSize)) fail("decrypting /puma/firmware.bin failed, check slot0x3DKeyX and slot0x2CKeyX");
+        }
+    }
+
+    printf("NATIVE_FIRM content %08X from %s, %.3f ms of host time up to patching\n", firmVersion, firmSource == FIRMWARE_SYSNAND ? "SysNAND" : "EmuNAND",
+           (double)(hostNs() - bootStart) / 1000000);
+
+    unmapImage(sd, sdSectors);
+    unmapImage(nand, nandSectors);
+
+    return 0;
+}
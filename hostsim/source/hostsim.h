@@ -0,0 +1,43 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+#pragma once
+
+#include "types.h"
+
+typedef struct FirmLoadOptions
+{
+    const char *keysPath;
+    const char *cidPath;
+    const char *nandPath;
+    const char *sdPath;
+    bool isN3DS;
+    bool emuNand;
+} FirmLoadOptions;
+
+void __attribute__((noreturn)) fail(const char *message, ...);
+
+int runChecks(void);
+int runFatBench(const char *imagePath);
+int runFirmLoad(const FirmLoadOptions *options);
+int runLzBench(const char *payloadPath, const char *lzPath);
+int runLoaderBench(u32 loadMs);
@@ -0,0 +1,128 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+//MAP_ANONYMOUS and MAP_NORESERVE
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "image.h"
+#include "hostsim.h"
+
+#define FAT32_RESERVED_SECTORS 32
+
+static void write16(u8 *dst, u16 value)
+{
+    dst[0] = (u8)value;
+    dst[1] = (u8)(value >> 8);
+}
+
+static void write32(u8 *dst, u32 value)
+{
+    write16(dst, (u16)value);
+    write16(dst + 2, (u16)(value >> 16));
+}
+
+static u8 *mapSectors(int fd, u32 sectors)
+{
+    u8 *data = mmap(NULL, (size_t)sectors * 0x200, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_NORESERVE | (fd < 0 ? MAP_ANONYMOUS : 0), fd, 0);
+
+    return data == MAP_FAILED ? NULL : data;
+}
+
+u8 *mapImage(const char *path, u32 *sectors)
+{
+    struct stat info;
+    int fd = open(path, O_RDONLY);
+
+    if(fd < 0 || fstat(fd, &info) != 0) fail("can't open %s", path);
+    if(info.st_size < 0x100000 || info.st_size / 0x200 > 0xFFFFFFFF) fail("%s is not a card image", path);
+
+    //SDHC capacities are counted in 512KB units
+    *sectors = (u32)(info.st_size / 0x200) & ~0x3FF;
+
+    u8 *data = mapSectors(fd, *sectors);
+    close(fd);
+    if(data == NULL) fail("can't map %s", path);
+
+    return data;
+}
+
+u8 *createFatImage(u32 sectors, u32 sectorsPerCluster)
+{
+    u8 *data = mapSectors(-1, sectors);
+    if(data == NULL) fail("out of memory");
+
+    //Big enough for as many clusters as there would be without the FATs
+    u32 fatSectors = (((sectors - FAT32_RESERVED_SECTORS) / sectorsPerCluster + 2) * 4 + 0x1FF) / 0x200,
+        clusters = (sectors - FAT32_RESERVED_SECTORS - 2 * fatSectors) / sectorsPerCluster;
+
+    if(clusters <= 0xFFF5) fail("%u sectors are too few for FAT32 with %u sectors per cluster", sectors, sectorsPerCluster);
+
+    //Boot sector
+    memcpy(data, "\xEB\x58\x90" "MSWIN4.1", 11);
+    write16(data + 11, 0x200);
+    data[13] = (u8)sectorsPerCluster;
+    write16(data + 14, FAT32_RESERVED_SECTORS);
+    data[16] = 2;                       //FATs
+    data[21] = 0xF8;                    //Fixed disk
+    write16(data + 24, 63);
+    write16(data + 26, 255);
+    write32(data + 32, sectors);
+    write32(data + 36, fatSectors);
+    write32(data + 44, 2);              //Root directory cluster
+    write16(data + 48, 1);              //FSInfo sector
+    write16(data + 50, 6);              //Backup boot sector
+    data[64] = 0x80;
+    data[66] = 0x29;
+    write32(data + 67, 0x3D5CA4D);
+    memcpy(data + 71, "NO NAME    FAT32   ", 19);
+    write16(data + 510, 0xAA55);
+    memcpy(data + 6 * 0x200, data, 0x200);
+
+    //FSInfo, without a free cluster count
+    u8 *fsInfo = data + 0x200;
+    write32(fsInfo, 0x41615252);
+    write32(fsInfo + 484, 0x61417272);
+    write32(fsInfo + 488, 0xFFFFFFFF);
+    write32(fsInfo + 492, 0xFFFFFFFF);
+    write32(fsInfo + 508, 0xAA550000);
+
+    //Media descriptor, reserved entry and the root directory's cluster, in both FATs
+    for(u32 fat = 0; fat < 2; fat++)
+    {
+        u8 *entries = data + (FAT32_RESERVED_SECTORS + fat * fatSectors) * 0x200;
+        write32(entries, 0x0FFFFFF8);
+        write32(entries + 4, 0x0FFFFFFF);
+        write32(entries + 8, 0x0FFFFFFF);
+    }
+
+    return data;
+}
+
+void unmapImage(u8 *data, u32 sectors)
+{
+    munmap(data, (size_t)sectors * 0x200);
+}
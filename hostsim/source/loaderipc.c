@@ -0,0 +1,298 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   hostsim loaderbench: the loader's service loop (injector/source/loader.c's main, with its session list) under
+*   several clients at once, on the kernel model of loaderipc.h. Reports how the requests of each client wait
+*   with one session, with several served lowest index first, and with several served round-robin
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include "hostsim.h"
+#include "loaderipc.h"
+#include "sessions.h"
+
+#define MAX_CLIENTS 16
+
+#define NOTIFICATION_HANDLE 1
+#define PORT_HANDLE         2
+#define FIRST_CLIENT_HANDLE 0x100
+
+#define SESSION_CLOSED (s32)0xC920181A //What svcReplyAndReceive returns for a session closed by the client
+
+#define NEVER UINT64_MAX
+
+typedef struct ClientState
+{
+    Handle handle;  //0 until accepted
+    u64 requestAt;  //When its next request is sent, NEVER while one is being served or once done
+    u64 sentAt;
+    u64 closeAt;    //When it closes its session, NEVER until it knows
+    bool removed;   //The loader closed its end
+} ClientState;
+
+static LoaderRun *run;
+static ClientState states[MAX_CLIENTS];
+static u64 now;
+static bool notified;
+
+static u32 clientIndex(Handle handle)
+{
+    if(handle < FIRST_CLIENT_HANDLE || handle - FIRST_CLIENT_HANDLE >= run->clientCount) fail("loader model: bad handle 0x%X", handle);
+
+    return handle - FIRST_CLIENT_HANDLE;
+}
+
+static bool isConnecting(u32 i)
+{
+    return states[i].handle == 0 && !run->clients[i].rejected && run->clients[i].connectUs <= now;
+}
+
+static bool isSignaled(Handle handle)
+{
+    if(handle == NOTIFICATION_HANDLE) return !notified && now >= run->durationUs;
+
+    if(handle == PORT_HANDLE)
+    {
+        for(u32 i = 0; i < run->clientCount; i++)
+            if(isConnecting(i)) return true;
+
+        return false;
+    }
+
+    ClientState *state = &states[clientIndex(handle)];
+
+    return state->closeAt <= now || state->requestAt <= now;
+}
+
+//Next time anything happens on the client side
+static u64 nextEvent(void)
+{
+    u64 next = notified || run->durationUs <= now ? NEVER : run->durationUs;
+
+    for(u32 i = 0; i < run->clientCount; i++)
+    {
+        ClientState *state = &states[i];
+        u64 times[3] = {state->handle == 0 && !run->clients[i].rejected ? run->clients[i].connectUs : NEVER,
+                        state->removed ? NEVER : state->requestAt,
+                        state->removed ? NEVER : state->closeAt};
+
+        for(u32 j = 0; j < 3; j++)
+            if(times[j] > now && times[j] < next) next = times[j];
+    }
+
+    return next;
+}
+
+static void reply(u32 i)
+{
+    LoaderClient *client = &run->clients[i];
+    ClientState *state = &states[i];
+    u64 wait = now - state->sentAt;
+
+    client->served++;
+    client->waitUs += wait;
+    if(wait > client->maxWaitUs) client->maxWaitUs = wait;
+
+    if(client->requests != 0 && client->served == client->requests) state->closeAt = now;
+    else state->requestAt = state->sentAt = now + client->thinkUs;
+}
+
+static Result svcReplyAndReceive(s32 *index, const Handle *handles, s32 handleCount, Handle replyTarget)
+{
+    if(replyTarget != 0)
+    {
+        u32 i = clientIndex(replyTarget);
+
+        if(states[i].closeAt <= now)
+        {
+            *index = -1;
+            return SESSION_CLOSED;
+        }
+        reply(i);
+    }
+
+    for(;;)
+    {
+        for(s32 i = 0; i < handleCount; i++)
+        {
+            if(!isSignaled(handles[i])) continue;
+
+            *index = i;
+            if(handles[i] < FIRST_CLIENT_HANDLE) return 0;
+
+            ClientState *state = &states[clientIndex(handles[i])];
+            if(state->closeAt <= now) return SESSION_CLOSED;
+            state->requestAt = NEVER;
+            return 0;
+        }
+
+        u64 next = nextEvent();
+        if(next == NEVER) fail("loader model: the loader waits for something that never happens");
+        now = next;
+    }
+}
+
+static Result svcAcceptSession(Handle *session, Handle port)
+{
+    if(port != PORT_HANDLE) fail("loader model: accept on handle 0x%X", port);
+
+    for(u32 i = 0; i < run->clientCount; i++)
+    {
+        if(!isConnecting(i)) continue;
+
+        *session = states[i].handle = FIRST_CLIENT_HANDLE + i;
+        return 0;
+    }
+
+    fail("loader model: accept with nothing connecting");
+}
+
+static void svcCloseHandle(Handle handle)
+{
+    u32 i = clientIndex(handle);
+
+    if(states[i].closeAt > now) run->clients[i].rejected = true;
+    states[i].removed = true;
+}
+
+//srv asked the loader to stop, which only happens once the clients are going away
+static void terminate(void)
+{
+    notified = true;
+    for(u32 i = 0; i < run->clientCount; i++)
+    {
+        if(states[i].closeAt > now) states[i].closeAt = now;
+        states[i].requestAt = NEVER;
+    }
+}
+
+//loader.c's main from srvSysRegisterService on, with handle_commands taking the client's time
+void simulateLoader(LoaderRun *loaderRun)
+{
+    static session_list_t sessions;
+    Handle handle,
+           replyTarget = 0;
+    s32 index;
+    bool termRequest = false;
+
+    if(loaderRun->clientCount > MAX_CLIENTS) fail("loader model: too many clients");
+
+    run = loaderRun;
+    now = 0;
+    notified = false;
+    for(u32 i = 0; i < run->clientCount; i++)
+    {
+        LoaderClient *client = &run->clients[i];
+
+        client->rejected = false;
+        client->served = 0;
+        client->waitUs = client->maxWaitUs = 0;
+        states[i] = (ClientState){.requestAt = client->connectUs, .sentAt = client->connectUs, .closeAt = NEVER};
+    }
+
+    sessions_init(&sessions, run->maxSessions);
+    sessions.handles[SESSION_NOTIFICATION] = NOTIFICATION_HANDLE;
+    sessions.handles[SESSION_PORT] = PORT_HANDLE;
+
+    do
+    {
+        Result ret = svcReplyAndReceive(&index, sessions.handles, sessions.count, replyTarget);
+
+        if(ret != 0)
+        {
+            if(ret != SESSION_CLOSED) fail("loader model: unexpected result 0x%08X", ret);
+            if(index == -1) index = sessions_find(&sessions, replyTarget);
+            if(index >= SESSION_FIRST)
+            {
+                svcCloseHandle(sessions.handles[index]);
+                sessions_remove(&sessions, index);
+            }
+            replyTarget = 0;
+        }
+        else
+        {
+            replyTarget = 0;
+            switch(index)
+            {
+                case SESSION_NOTIFICATION:
+                    terminate();
+                    termRequest = true;
+                    break;
+                case SESSION_PORT:
+                    svcAcceptSession(&handle, sessions.handles[SESSION_PORT]);
+                    if(!sessions_add(&sessions, handle)) svcCloseHandle(handle);
+                    break;
+                default:
+                    now += run->clients[clientIndex(sessions.handles[index])].serviceUs;
+                    replyTarget = sessions.handles[index];
+                    if(run->roundRobin) sessions_served(&sessions, index);
+                    break;
+            }
+        }
+    }
+    while(!termRequest || sessions.count != SESSION_FIRST);
+
+    run->endUs = now;
+}
+
+static void report(const char *title, LoaderClient *clients, u32 clientCount, int maxSessions, bool roundRobin, u32 loadUs)
+{
+    LoaderRun loaderRun = {clients, clientCount, maxSessions, roundRobin, 10000000, 0};
+    u32 loads = 0;
+
+    simulateLoader(&loaderRun);
+
+    printf("%s:\n", title);
+    for(u32 i = 0; i < clientCount; i++)
+    {
+        LoaderClient *client = &clients[i];
+
+        if(client->serviceUs == loadUs) loads += client->served;
+        if(client->rejected) printf("  %-16s session refused\n", client->name);
+        else printf("  %-16s %7u requests, wait %6llu us on average, %6llu us at most\n", client->name, client->served,
+                    client->served == 0 ? 0ULL : (unsigned long long)(client->waitUs / client->served),
+                    (unsigned long long)client->maxWaitUs);
+    }
+    printf("  %.1f loads/s\n", loads * 1e6 / loaderRun.endUs);
+}
+
+int runLoaderBench(u32 loadMs)
+{
+    //pm and a second launcher (a homebrew launcher, say) each start a title a millisecond after the last one is up,
+    //while two tools poll GetMetrics (LOADER_GET_METRICS) every 100us
+    LoaderClient clients[] = {
+        {.name = "pm", .serviceUs = loadMs * 1000, .thinkUs = 1000},
+        {.name = "metrics poller", .serviceUs = 30, .thinkUs = 100},
+        {.name = "second launcher", .serviceUs = loadMs * 1000, .thinkUs = 1000},
+        {.name = "metrics poller", .serviceUs = 30, .thinkUs = 100}
+    };
+    u32 clientCount = sizeof(clients) / sizeof(clients[0]);
+
+    printf("LoadProcess taking %u ms, GetMetrics 30 us, over 10 s of simulated time\n", loadMs);
+    report("1 session (MAX_SESSIONS before)", clients, clientCount, 1, false, loadMs * 1000);
+    report("4 sessions, lowest index first", clients, clientCount, 4, false, loadMs * 1000);
+    report("4 sessions, round-robin (sessions_served)", clients, clientCount, 4, true, loadMs * 1000);
+
+    return 0;
+}
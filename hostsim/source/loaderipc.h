@@ -0,0 +1,59 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   Model of the kernel side of the loader's service loop: clients connecting to the port, sending requests on their
+*   sessions and closing them, and svcReplyAndReceive picking the lowest signaled handle. The loop itself is loader.c's,
+*   with its session list (injector/source/sessions.c), and runs on a simulated clock: each request takes the loader
+*   the time its client says, so the results are the scheduling alone, not the loader's speed
+*/
+
+#pragma once
+
+#include "types.h"
+
+typedef struct LoaderClient
+{
+    const char *name;
+    u32 connectUs;  //When it connects to the port
+    u32 serviceUs;  //What the loader spends on each of its requests
+    u32 thinkUs;    //From a reply to its next request
+    u32 requests;   //It closes its session after that many, 0 for no limit
+
+    //Results
+    bool rejected;  //The loader closed its session right away
+    u32 served;
+    u64 waitUs;     //From sending each request to its reply, summed
+    u64 maxWaitUs;
+} LoaderClient;
+
+typedef struct LoaderRun
+{
+    LoaderClient *clients;
+    u32 clientCount;
+    int maxSessions;
+    bool roundRobin; //false leaves the session list alone after a request, like before sessions_served
+    u64 durationUs;  //srv asks the loader to terminate then, and the clients close their sessions
+    u64 endUs;       //When the service loop returned
+} LoaderRun;
+
+void simulateLoader(LoaderRun *run);
@@ -0,0 +1,282 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   hostsim lzbench: what an LZ-compressed arm9loaderhax.bin behind a decompressing stub would save in SD reads against
+*   what decompressLz costs. The reads go through fileRead on the SD card model, the decompression runs the payload's
+*   decompressLz on the host, and its ARM9 time is estimated from what it had to do
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "hostsim.h"
+#include "image.h"
+#include "tmio.h"
+#include "fs.h"
+
+#define MAX_PAYLOAD_SIZE 0x100000
+
+//Rough ARM946E-S costs of the decompressLz loop (byte loads/stores, compare and taken branch each),
+//with the decompressor's code and data cached
+#define CYCLES_PER_FLAG_BYTE   6
+#define CYCLES_PER_LITERAL     8
+#define CYCLES_PER_REFERENCE   14
+#define CYCLES_PER_COPIED_BYTE 7
+#define ARM9_CLOCK             67027964 //The bootROM leaves it at 67MHz on both consoles
+
+#define HASH_SIZE   0x10000
+#define MAX_CHAIN   512
+
+u32 arm9_decompressLz(void *dest, const void *src); //memory.c's decompressLz, renamed by the Makefile
+
+typedef struct LzStats
+{
+    u32 flagBytes;
+    u32 literals;
+    u32 references;
+    u32 copiedBytes;
+} LzStats;
+
+static u32 hash3(const u8 *data)
+{
+    return ((data[0] << 8) ^ (data[1] << 4) ^ data[2]) & (HASH_SIZE - 1);
+}
+
+//Greedy LZ77 (type 0x10) with hash chains, close to what gbalzss produces
+static u32 compressLz(u8 *dest, const u8 *src, u32 size)
+{
+    static int32_t head[HASH_SIZE],
+                   previous[MAX_PAYLOAD_SIZE];
+    u32 in = 0,
+        out = 4;
+
+    memset(head, 0xFF, sizeof(head));
+
+    dest[0] = 0x10;
+    dest[1] = (u8)size;
+    dest[2] = (u8)(size >> 8);
+    dest[3] = (u8)(size >> 16);
+
+    while(in < size)
+    {
+        u32 flagsPos = out++;
+        dest[flagsPos] = 0;
+
+        for(u32 i = 0; i < 8 && in < size; i++)
+        {
+            u32 bestLength = 0,
+                bestDisplacement = 0;
+
+            if(in + 3 <= size)
+            {
+                u32 chain = 0;
+
+                for(int32_t candidate = head[hash3(src + in)]; candidate >= 0 && in - candidate <= 0x1000 && chain < MAX_CHAIN;
+                    candidate = previous[candidate], chain++)
+                {
+                    u32 length = 0;
+                    while(length < 18 && in + length < size && src[candidate + length] == src[in + length]) length++;
+
+                    if(length > bestLength)
+                    {
+                        bestLength = length;
+                        bestDisplacement = in - candidate;
+                        if(length == 18) break;
+                    }
+                }
+            }
+
+            u32 advance = bestLength >= 3 ? bestLength : 1;
+
+            if(bestLength >= 3)
+            {
+                dest[flagsPos] |= 0x80 >> i;
+                dest[out++] = (u8)(((bestLength - 3) << 4) | ((bestDisplacement - 1) >> 8));
+                dest[out++] = (u8)(bestDisplacement - 1);
+            }
+            else dest[out++] = src[in];
+
+            for(u32 j = 0; j < advance; j++, in++)
+            {
+                if(in + 3 > size) continue;
+
+                u32 hash = hash3(src + in);
+                previous[in] = head[hash];
+                head[hash] = (int32_t)in;
+            }
+        }
+    }
+
+    return out;
+}
+
+//Walks the stream like decompressLz does, counting what it does
+static void countLz(const u8 *src, LzStats *stats)
+{
+    const u8 *in = src + 4;
+    u32 size = src[1] | (src[2] << 8) | (src[3] << 16),
+        out = 0;
+
+    memset(stats, 0, sizeof(LzStats));
+
+    while(out < size)
+    {
+        u8 flags = *in++;
+        stats->flagBytes++;
+
+        for(u32 i = 0; i < 8 && out < size; i++, flags <<= 1)
+        {
+            if(flags & 0x80)
+            {
+                u32 length = (in[0] >> 4) + 3;
+                if(length > size - out) length = size - out;
+
+                in += 2;
+                out += length;
+                stats->references++;
+                stats->copiedBytes += length;
+            }
+            else
+            {
+                in++;
+                out++;
+                stats->literals++;
+            }
+        }
+    }
+}
+
+static u8 *readFile(const char *path, u32 *size)
+{
+    static u8 buffer[MAX_PAYLOAD_SIZE + 1];
+    FILE *file = fopen(path, "rb");
+
+    if(file == NULL) fail("can't open %s", path);
+    *size = (u32)fread(buffer, 1, sizeof(buffer), file);
+    fclose(file);
+
+    if(*size == 0 || *size > MAX_PAYLOAD_SIZE) fail("%s is empty or bigger than 1MB", path);
+
+    u8 *data = malloc(*size);
+    if(data == NULL) fail("out of memory");
+    memcpy(data, buffer, *size);
+
+    return data;
+}
+
+static Card sdCard,
+            nandCard;
+
+//The whole file through FatFs and the driver, on a card left idle before
+static u64 timeRead(const char *path, void *dest, u32 size, u32 *commands)
+{
+    u32 before = sdCard.stats.commands;
+    u64 start = hostNs();
+
+    if(fileRead(dest, path, size) != size) fail("reading %s back failed", path);
+
+    u64 time = hostNs() - start;
+    *commands = sdCard.stats.commands - before;
+
+    return time;
+}
+
+int runLzBench(const char *payloadPath, const char *lzPath)
+{
+    static u8 nand[0x1000 * 0x200];
+    u32 size,
+        lzSize;
+    u8 *payload = readFile(payloadPath, &size),
+       *lz,
+       *unpacked = malloc(size);
+
+    if(unpacked == NULL) fail("out of memory");
+
+    if(lzPath != NULL)
+    {
+        lz = readFile(lzPath, &lzSize);
+        if(lzSize < 4 || lz[0] != 0x10 || (u32)(lz[1] | (lz[2] << 8) | (lz[3] << 16)) != size)
+            fail("%s isn't an LZ77 (type 0x10) image of %s", lzPath, payloadPath);
+    }
+    else
+    {
+        lz = malloc(size + size / 8 + 16);
+        if(lz == NULL) fail("out of memory");
+        lzSize = compressLz(lz, payload, size);
+    }
+
+    //The payload's own decompressLz
+    u64 decompressTime = UINT64_MAX;
+    for(u32 run = 0; run < 5; run++)
+    {
+        memset(unpacked, 0, size);
+
+        u64 start = hostNs();
+        arm9_decompressLz(unpacked, lz);
+        u64 time = hostNs() - start;
+        if(time < decompressTime) decompressTime = time;
+    }
+    if(memcmp(unpacked, payload, size) != 0) fail("the LZ image doesn't decompress to %s", payloadPath);
+
+    //Both files on a blank card
+    u32 sectors = 0x800000;
+    u8 *image = createFatImage(sectors, 64);
+
+    cardInit(&nandCard, nand, sizeof(nand) / 0x200, true);
+    tmioInsert(TMIO_PORT_NAND, &nandCard);
+    cardInit(&sdCard, image, sectors, false);
+    tmioInsert(TMIO_PORT_SD, &sdCard);
+    mountFs();
+
+    if(!fileWrite(payload, "/plain.bin", size) || !fileWrite(lz, "/compressed.bin", lzSize)) fail("can't write the payloads");
+
+    u32 plainCommands,
+        lzCommands;
+    u64 plainTime = timeRead("/plain.bin", unpacked, size, &plainCommands),
+        lzTime = timeRead("/compressed.bin", unpacked, lzSize, &lzCommands);
+
+    LzStats stats;
+    countLz(lz, &stats);
+    u64 cycles = (u64)stats.flagBytes * CYCLES_PER_FLAG_BYTE + (u64)stats.literals * CYCLES_PER_LITERAL +
+                 (u64)stats.references * CYCLES_PER_REFERENCE + (u64)stats.copiedBytes * CYCLES_PER_COPIED_BYTE;
+    double arm9Ms = (double)cycles * 1000 / ARM9_CLOCK,
+           savedMs = (double)(plainTime - lzTime) / 1000000;
+
+    printf("%s: %u bytes, LZ image%s: %u bytes (%.1f%%)\n", payloadPath, size, lzPath != NULL ? "" : " (made here)", lzSize,
+           (double)lzSize * 100 / size);
+    printf("SD read at HCLK/%u: %.3f ms (%u commands) plain, %.3f ms (%u commands) compressed, %.3f ms saved\n",
+           tmioClockDivider(), (double)plainTime / 1000000, plainCommands, (double)lzTime / 1000000, lzCommands, savedMs);
+    printf("decompressLz: %u literals, %u back-references copying %u bytes, %.3f ms on the host\n",
+           stats.literals, stats.references, stats.copiedBytes, (double)decompressTime / 1000000);
+    printf("  estimated %llu ARM9 cycles, %.3f ms at 67MHz\n", (unsigned long long)cycles, arm9Ms);
+    printf("Compressed image: %.3f ms %s\n", savedMs > arm9Ms ? savedMs - arm9Ms : arm9Ms - savedMs, savedMs > arm9Ms ? "faster" : "slower");
+    //Whatever reads the payload (the bootloader, not this driver), the bytes not read have to take longer than decompressing
+    printf("  break-even: the compressed image only wins when the payload is read at under %.0f KB/s (the model: %.0f KB/s)\n",
+           (double)(size - lzSize) / 1024 / (arm9Ms / 1000), (double)size / 1024 / ((double)plainTime / 1000000000));
+
+    unmapImage(image, sectors);
+    free(payload);
+    free(lz);
+    free(unpacked);
+
+    return 0;
+}
@@ -0,0 +1,112 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   hostsim: runs payload code (the SD/MMC driver, FatFs with the file functions, EmuNAND location, the FIRM crypto
+*   and the ARM11 worker queue for now) on the host against models of the console hardware, to check it and to time it
+*   without a console. The loader's service loop runs here too, against a model of its clients
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hostsim.h"
+
+void fail(const char *message, ...)
+{
+    va_list arguments;
+
+    fflush(stdout);
+    va_start(arguments, message);
+    fprintf(stderr, "hostsim: ");
+    vfprintf(stderr, message, arguments);
+    fputc('\n', stderr);
+    va_end(arguments);
+
+    exit(1);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: hostsim check\n"
+                    "       hostsim fatbench [sd.img]\n"
+                    "       hostsim firmload -k aes_keys.txt [-i nand_cid.bin] [-c o3ds|n3ds] [-e] nand.img [sd.img]\n"
+                    "       hostsim lzbench main.bin [main.bin.lz]\n"
+                    "       hostsim loaderbench [load_ms]\n\n"
+                    "check: runs the payload's SD/MMC driver and CTRNAND reads against a model of the controller\n"
+                    "       and of scriptable cards, and the ARM11 worker queue with the worker on a thread,\n"
+                    "       and the loader's session list in its service loop, and checks the results.\n"
+                    "       Exits with 1 if any check fails.\n"
+                    "fatbench: writes files of the sizes the payload writes with fileWrite, and with FatFs alone,\n"
+                    "          on a blank 4GB FAT32 volume or on a copy of an SD card image, and reports the\n"
+                    "          time and the SD commands they take. The image file itself is left untouched.\n"
+                    "firmload: mounts the SD card and CTRNAND, locates the EmuNAND (-e) and loads and decrypts NATIVE_FIRM\n"
+                    "          like the payload does, and reports the host time and the card commands of each stage.\n"
+                    "          It stops there: no config, patching or launch. The key file (firmprep's format) needs\n"
+                    "          the CTRNAND key (slot0x04KeyN, or slot0x05KeyX on N3DS) and slot0x2CKeyX, plus slot0x3DKeyX\n"
+                    "          for an encrypted /puma/firmware.bin. The NAND counter comes from the CID.\n"
+                    "          Without an SD card image, a blank one is used.\n"
+                    "lzbench: compares reading the payload from the SD card with reading its LZ image (gbalzss output,\n"
+                    "         or compressed here) and decompressing it, as a self-decompressing payload would. The\n"
+                    "         decompression is timed on the host and estimated in ARM9 cycles.\n"
+                    "loaderbench: runs the loader's service loop against a model of its clients and of svcReplyAndReceive,\n"
+                    "             with two launchers (LoadProcess taking load_ms, 40 by default) and two GetMetrics pollers,\n"
+                    "             and reports how long each one's requests wait with one session and with four.\n");
+    exit(1);
+}
+
+static int firmLoad(int argc, char **argv)
+{
+    FirmLoadOptions options = {0};
+    const char *console = NULL;
+    int i;
+
+    for(i = 2; i < argc && argv[i][0] == '-'; i++)
+    {
+        if(strcmp(argv[i], "-k") == 0 && i + 1 < argc) options.keysPath = argv[++i];
+        else if(strcmp(argv[i], "-i") == 0 && i + 1 < argc) options.cidPath = argv[++i];
+        else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc) console = argv[++i];
+        else if(strcmp(argv[i], "-e") == 0) options.emuNand = true;
+        else usage();
+    }
+
+    if(options.keysPath == NULL || argc - i < 1 || argc - i > 2 || (console != NULL && strcmp(console, "o3ds") != 0 && strcmp(console, "n3ds") != 0)) usage();
+    if(options.emuNand && argc - i != 2) usage();
+
+    options.nandPath = argv[i];
+    options.sdPath = argc - i == 2 ? argv[i + 1] : NULL;
+    options.isN3DS = console != NULL && strcmp(console, "n3ds") == 0;
+
+    return runFirmLoad(&options);
+}
+
+int main(int argc, char **argv)
+{
+    if(argc == 2 && strcmp(argv[1], "check") == 0) return runChecks();
+    if((argc == 2 || argc == 3) && strcmp(argv[1], "fatbench") == 0) return runFatBench(argc == 3 ? argv[2] : NULL);
+    if(argc >= 2 && strcmp(argv[1], "firmload") == 0) return firmLoad(argc, argv);
+    if((argc == 3 || argc == 4) && strcmp(argv[1], "lzbench") == 0) return runLzBench(argv[2], argc == 4 ? argv[3] : NULL);
+    if((argc == 2 || argc == 3) && strcmp(argv[1], "loaderbench") == 0) return runLoaderBench(argc == 3 ? (u32)atoi(argv[2]) : 40);
+
+    usage();
+}
@@ -0,0 +1,104 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   What the payload files built into hostsim expect from the rest of the payload
+*/
+
+#include "hostsim.h"
+#include "cache.h"
+#include "screen.h"
+#include "utils.h"
+#include "draw.h"
+
+bool isN3DS = false,
+     isDevUnit = false,
+     isA9lh = true,
+     isFirmlaunch = false;
+u32 emuOffset = 0;
+FirmwareSource firmSource = FIRMWARE_SYSNAND;
+
+//Nothing is bundled, fs.c, emunand.c and exceptions.c only need the symbols
+const u8 loader_bin_lz[4],
+         emunand_bin[4],
+         arm9_exceptions_bin_lz[4],
+         arm11_exceptions_bin_lz[4];
+const u32 emunand_bin_size = 0;
+
+void error(const char *message)
+{
+    fail("the payload failed: %s", message);
+}
+
+void initScreens(void)
+{
+}
+
+//Nothing is shown, exception dumps are checked in headless mode
+u32 drawString(const char *string, bool isTopScreen, u32 posX, u32 posY, u32 color)
+{
+    (void)string;
+    (void)isTopScreen;
+    (void)posX;
+    (void)color;
+
+    return posY;
+}
+
+void drawCharacter(char character, bool isTopScreen, u32 posX, u32 posY, u32 color)
+{
+    (void)character;
+    (void)isTopScreen;
+    (void)posX;
+    (void)posY;
+    (void)color;
+}
+
+u32 waitInput(void)
+{
+    fail("the payload waits for a button");
+}
+
+void mcuPowerOff(void)
+{
+    fail("the payload powered off");
+}
+
+//The ARM9 flushes the data cache before the ARM11 reads what it wrote and the other way round,
+//which on the host is where the threads need a fence
+void flushEntireDCache(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void flushDCacheRange(void *startAddress, u32 size)
+{
+    (void)startAddress;
+    (void)size;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void flushICacheRange(void *startAddress, u32 size)
+{
+    (void)startAddress;
+    (void)size;
+}
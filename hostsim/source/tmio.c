@@ -0,0 +1,559 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+#include <string.h>
+#include <time.h>
+#include "tmio.h"
+#include "fatfs/sdmmc/sdmmc.h"
+#include "fatfs/sdmmc/delay.h"
+
+#define HCLK 67027964u
+
+//REG_DATACTL32 bits reporting the state of the 32-bit FIFO
+#define DATACTL32_RXFULL 0x100
+#define DATACTL32_TXBUSY 0x200
+
+//Card status in R1 responses: ready for data, in the transfer state
+#define R1_TRANSFER      0x900
+#define R1_APP_CMD       0x20
+
+static Card *ports[2];
+static u16 regs[0x200 / 2];
+static u16 status0,
+           status1;
+static u32 response[4];
+
+static struct
+{
+    Card *card;
+    bool active;
+    bool isRead;
+    bool blockPending; //Read: a block is in the FIFO. Write: the card is programming the last block
+    u32 sector;
+    u32 blocksLeft;
+    u32 blockSize;
+    u32 position;
+    u64 readyAt;       //When the next block is in (reads), or when the card takes the next one (writes)
+    const u8 *source;  //Data which doesn't come from the sectors (CMD6 status)
+    u8 fifo[0x200];
+} transfer;
+
+u64 hostNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (u64)now.tv_sec * 1000000000u + (u64)now.tv_nsec;
+}
+
+u32 tmioSelectedPort(void)
+{
+    return regs[REG_SDPORTSEL / 2] & 3;
+}
+
+u32 tmioClockDivider(void)
+{
+    u32 divider = 2;
+
+    for(u32 bits = regs[REG_SDCLKCTL / 2] & 0xFF; bits != 0; bits >>= 1) divider <<= 1;
+
+    return divider;
+}
+
+static u64 busNs(u32 clocks)
+{
+    return (u64)clocks * tmioClockDivider() * 1000000000u / HCLK;
+}
+
+//Start bit, data, CRC16 on each line and end bit
+static u32 blockClocks(u32 size)
+{
+    return ((regs[REG_SDOPT / 2] & 0x8000) ? size * 8 : size * 2) + 18;
+}
+
+static void setBits(u32 *raw, u32 high, u32 low, u32 value)
+{
+    for(u32 bit = low; bit <= high; bit++, value >>= 1)
+        if(value & 1) raw[bit / 32] |= 1u << (bit % 32);
+}
+
+//R2 responses lose the CRC byte, the controller shifts the rest down
+static void respondLong(const u32 *raw)
+{
+    for(u32 i = 0; i < 3; i++) response[i] = (raw[i] >> 8) | (raw[i + 1] << 24);
+    response[3] = raw[3] >> 8;
+
+    status0 |= TMIO_STAT0_CMDRESPEND;
+}
+
+static void respond(u32 value)
+{
+    response[0] = value;
+    response[1] = response[2] = response[3] = 0;
+
+    status0 |= TMIO_STAT0_CMDRESPEND;
+}
+
+static void timeOut(Card *card, u16 error)
+{
+    status1 |= error;
+    if(card != NULL) card->stats.timeouts++;
+}
+
+static void sendCid(const Card *card)
+{
+    if(card->cid != NULL)
+    {
+        memcpy(response, card->cid, sizeof(response));
+        status0 |= TMIO_STAT0_CMDRESPEND;
+        return;
+    }
+
+    u32 raw[4] = {0};
+
+    setBits(raw, 127, 120, card->isMmc ? 0x15 : 0x03);  //Manufacturer
+    setBits(raw, 103, 72, card->isMmc ? 0x4E414E44 : 0x53445344); //Product name
+    setBits(raw, 55, 24, 0x12345678 ^ card->sectors);   //Serial number
+    respondLong(raw);
+}
+
+static void sendCsd(const Card *card)
+{
+    u32 raw[4] = {0};
+
+    setBits(raw, 103, 96, 0x32); //25MHz
+    setBits(raw, 95, 84, card->ccc);
+    setBits(raw, 83, 80, 9);     //512-byte blocks
+
+    if(card->isSdhc)
+    {
+        setBits(raw, 127, 126, 1);
+        setBits(raw, 69, 48, card->sectors / 1024 - 1);
+    }
+    else
+    {
+        //Capacity is (C_SIZE + 1) * 2^(C_SIZE_MULT + 2) blocks, with a 12-bit C_SIZE
+        u32 mult = 0;
+        while(mult < 7 && (card->sectors / (4u << mult) > 4096 || card->sectors % (4u << mult) != 0)) mult++;
+
+        setBits(raw, 127, 126, card->isMmc ? 2 : 0);
+        setBits(raw, 73, 62, card->sectors / (4u << mult) - 1);
+        setBits(raw, 49, 47, mult);
+    }
+
+    respondLong(raw);
+}
+
+//Whether a data block gets through at the current clock
+static bool blockIsCorrupted(Card *card)
+{
+    if(tmioClockDivider() != 2) return false;
+    if(card->inHighSpeed && card->highSpeedCrcErrors == 0) return false;
+
+    if(card->inHighSpeed && card->crcErrorDelay != 0)
+    {
+        card->crcErrorDelay--;
+        return false;
+    }
+
+    if(card->highSpeedCrcErrors != 0) card->highSpeedCrcErrors--;
+    card->stats.crcErrors++;
+
+    return true;
+}
+
+static void startTransfer(Card *card, bool isRead, u32 sector, u32 blocks, const u8 *source)
+{
+    u32 blockSize = regs[REG_SDBLKLEN32 / 2];
+
+    transfer.card = card;
+    transfer.active = true;
+    transfer.isRead = isRead;
+    transfer.blockPending = false;
+    transfer.sector = sector;
+    transfer.blocksLeft = blocks;
+    transfer.blockSize = blockSize == 0 || blockSize > 0x200 ? 0x200 : blockSize;
+    transfer.position = 0;
+    transfer.source = source;
+    transfer.readyAt = hostNs() + card->accessNs + (isRead ? busNs(blockClocks(transfer.blockSize)) : 0);
+
+    respond(R1_TRANSFER);
+}
+
+static void startSectorTransfer(Card *card, bool isRead, u32 argument)
+{
+    u32 sector = card->isSdhc ? argument : argument >> 9,
+        blocks = regs[REG_SDBLKCOUNT32 / 2];
+
+    if(!card->selected || blocks == 0 || sector >= card->sectors || blocks > card->sectors - sector)
+    {
+        timeOut(card, TMIO_STAT1_DATATIMEOUT);
+        return;
+    }
+
+    if(isRead) card->stats.readCommands++;
+    else card->stats.writeCommands++;
+
+    startTransfer(card, isRead, sector, blocks, NULL);
+}
+
+//CMD6 on SD cards: function group 1 only, the others stay on their default function
+static void switchFunction(Card *card, u32 argument)
+{
+    static u8 switchStatus[64];
+    u32 function = argument & 0xF;
+    bool supported = function == 0 || (function == 1 && card->highSpeed);
+
+    if(!(card->ccc & 0x400) || !card->selected)
+    {
+        timeOut(card, TMIO_STAT1_CMDTIMEOUT);
+        return;
+    }
+
+    memset(switchStatus, 0, sizeof(switchStatus));
+    switchStatus[1] = 200;                                //Maximum current (mA)
+    switchStatus[12] = 0x80;                              //Group 1 support
+    switchStatus[13] = card->highSpeed ? 0x03 : 0x01;
+    switchStatus[16] = function == 0xF ? (card->inHighSpeed ? 1 : 0) : (supported ? function : 0xF);
+    switchStatus[17] = 1;                                 //Data structure version
+
+    if((argument & 0x80000000) && function != 0xF && supported) card->inHighSpeed = function == 1;
+
+    startTransfer(card, true, 0, 1, switchStatus);
+}
+
+static void runCommand(u16 command, u32 argument)
+{
+    Card *card = ports[tmioSelectedPort() & 1];
+    u32 index = command & 0x3F;
+    bool isAcmd = (command & 0xC0) == 0x40;
+
+    transfer.active = false;
+
+    if(card == NULL)
+    {
+        timeOut(NULL, TMIO_STAT1_CMDTIMEOUT);
+        return;
+    }
+
+    card->stats.commands++;
+    card->stats.busNs += busNs((command & 0x700) == 0x600 ? 194 : 106);
+
+    bool appCmd = card->appCmd;
+    card->appCmd = false;
+
+    if(isAcmd && !appCmd)
+    {
+        card->stats.strayAcmds++;
+        timeOut(card, TMIO_STAT1_CMDTIMEOUT);
+        return;
+    }
+
+    switch(isAcmd ? 0x40 | index : index)
+    {
+        case 0:
+            card->rca = 0;
+            card->ocrPolls = 0;
+            card->selected = false;
+            card->inHighSpeed = false;
+            respond(0);
+            break;
+        case 1:
+            if(!card->isMmc) timeOut(card, TMIO_STAT1_CMDTIMEOUT);
+            else respond(++card->ocrPolls < 3 ? 0x00FF8080 : 0x80FF8080);
+            break;
+        case 2:
+        case 10:
+            sendCid(card);
+            break;
+        case 3:
+            if(card->isMmc)
+            {
+                card->rca = argument >> 16;
+                respond(0x500);
+            }
+            else
+            {
+                card->rca = 0xB368;
+                respond((card->rca << 16) | 0x500);
+            }
+            break;
+        case 6:
+            if(card->isMmc) respond(R1_TRANSFER); //SWITCH (EXT_CSD)
+            else switchFunction(card, argument);
+            break;
+        case 7:
+            card->selected = card->rca != 0 && argument >> 16 == card->rca;
+            respond(R1_TRANSFER);
+            break;
+        case 8:
+            if(card->isMmc) timeOut(card, TMIO_STAT1_CMDTIMEOUT);
+            else respond(argument & 0xFFF);
+            break;
+        case 9:
+            sendCsd(card);
+            break;
+        case 12:
+        case 13:
+        case 16:
+            respond(R1_TRANSFER);
+            break;
+        case 18:
+            startSectorTransfer(card, true, argument);
+            break;
+        case 25:
+            if(card->failedWrites != 0)
+            {
+                card->failedWrites--;
+                timeOut(card, TMIO_STAT1_CMDTIMEOUT);
+            }
+            else startSectorTransfer(card, false, argument);
+            break;
+        case 55:
+            if(card->failedCmd55s != 0)
+            {
+                card->failedCmd55s--;
+                timeOut(card, TMIO_STAT1_CMDTIMEOUT);
+            }
+            else if(card->isMmc || argument >> 16 != card->rca) timeOut(card, TMIO_STAT1_CMDTIMEOUT);
+            else
+            {
+                card->appCmd = true;
+                respond(R1_TRANSFER | R1_APP_CMD);
+            }
+            break;
+        case 0x40 | 6:
+            respond(R1_TRANSFER);
+            break;
+        case 0x40 | 23:
+            if(card->noPreErase) timeOut(card, TMIO_STAT1_CMDTIMEOUT);
+            else
+            {
+                card->stats.preErasedBlocks += argument & 0x7FFFFF;
+                respond(R1_TRANSFER);
+            }
+            break;
+        case 0x40 | 41:
+            respond((++card->ocrPolls < 3 ? 0 : 0x80000000) | (card->isSdhc && (argument & 0x40000000) ? 0x40000000 : 0) | 0xFF8000);
+            break;
+        default:
+            timeOut(card, TMIO_STAT1_CMDTIMEOUT);
+            break;
+    }
+}
+
+static void endTransfer(void)
+{
+    transfer.active = false;
+    status0 |= TMIO_STAT0_DATAEND;
+}
+
+static void updateTransfer(void)
+{
+    if(!transfer.active || hostNs() < transfer.readyAt) return;
+
+    Card *card = transfer.card;
+
+    if(transfer.isRead)
+    {
+        if(transfer.blockPending) return;
+
+        card->stats.busNs += busNs(blockClocks(transfer.blockSize));
+
+        if(blockIsCorrupted(card))
+        {
+            transfer.active = false;
+            status1 |= TMIO_STAT1_CRCFAIL;
+            return;
+        }
+
+        memcpy(transfer.fifo, transfer.source != NULL ? transfer.source : card->data + transfer.sector * 0x200, transfer.blockSize);
+        transfer.blockPending = true;
+        transfer.position = 0;
+        status1 |= TMIO_STAT1_RXRDY;
+        card->stats.blocksRead++;
+    }
+    else if(transfer.blockPending)
+    {
+        //The last block has been programmed
+        transfer.blockPending = false;
+        if(--transfer.blocksLeft == 0) endTransfer();
+        else status1 |= TMIO_STAT1_TXRQ;
+    }
+}
+
+static u32 readFifo(void)
+{
+    u32 word = 0;
+
+    updateTransfer();
+    if(!transfer.active || !transfer.isRead || !transfer.blockPending) return 0;
+
+    memcpy(&word, transfer.fifo + transfer.position, 4);
+    transfer.position += 4;
+
+    if(transfer.position == transfer.blockSize)
+    {
+        transfer.blockPending = false;
+        transfer.sector++;
+        status1 &= ~TMIO_STAT1_RXRDY;
+
+        if(--transfer.blocksLeft == 0) endTransfer();
+        else transfer.readyAt = hostNs() + busNs(blockClocks(transfer.blockSize));
+    }
+
+    return word;
+}
+
+static void writeFifo(u32 word)
+{
+    updateTransfer();
+    if(!transfer.active || transfer.isRead || transfer.blockPending || hostNs() < transfer.readyAt) return;
+
+    memcpy(transfer.fifo + transfer.position, &word, 4);
+    transfer.position += 4;
+
+    if(transfer.position == transfer.blockSize)
+    {
+        Card *card = transfer.card;
+
+        transfer.position = 0;
+        card->stats.busNs += busNs(blockClocks(transfer.blockSize));
+
+        if(blockIsCorrupted(card))
+        {
+            transfer.active = false;
+            status1 |= TMIO_STAT1_CRCFAIL;
+            return;
+        }
+
+        memcpy(card->data + transfer.sector * 0x200, transfer.fifo, 0x200);
+        transfer.sector++;
+        card->stats.blocksWritten++;
+
+        transfer.blockPending = true;
+        transfer.readyAt = hostNs() + busNs(blockClocks(transfer.blockSize)) + card->programNs;
+        status1 &= ~TMIO_STAT1_TXRQ;
+    }
+}
+
+u16 sdmmc_read16(u16 reg)
+{
+    switch(reg)
+    {
+        case REG_SDSTATUS0:
+            updateTransfer();
+            return status0 | (ports[TMIO_PORT_SD] != NULL ? TMIO_STAT0_SIGSTATE : 0);
+        case REG_SDSTATUS1:
+            updateTransfer();
+            return status1;
+        case REG_DATACTL32:
+        {
+            u16 value = regs[reg / 2];
+
+            updateTransfer();
+            if(transfer.active && transfer.isRead && transfer.blockPending) value |= DATACTL32_RXFULL;
+            if(!transfer.active || transfer.isRead || transfer.blockPending || hostNs() < transfer.readyAt) value |= DATACTL32_TXBUSY;
+
+            return value;
+        }
+        case REG_SDRESP0:
+        case REG_SDRESP1:
+        case REG_SDRESP2:
+        case REG_SDRESP3:
+        case REG_SDRESP4:
+        case REG_SDRESP5:
+        case REG_SDRESP6:
+        case REG_SDRESP7:
+        {
+            u32 half = (reg - REG_SDRESP0) / 2;
+            return (u16)(response[half / 2] >> ((half & 1) * 16));
+        }
+        default:
+            return reg < sizeof(regs) ? regs[reg / 2] : 0;
+    }
+}
+
+void sdmmc_write16(u16 reg, u16 val)
+{
+    switch(reg)
+    {
+        //Writing clears the bits which are 0
+        case REG_SDSTATUS0:
+            status0 &= val;
+            break;
+        case REG_SDSTATUS1:
+            status1 &= val;
+            break;
+        case REG_DATACTL32:
+            regs[reg / 2] = val & ~(DATACTL32_RXFULL | DATACTL32_TXBUSY);
+            break;
+        case REG_SDCMD:
+            regs[reg / 2] = val;
+            runCommand(val, regs[REG_SDCMDARG0 / 2] | ((u32)regs[REG_SDCMDARG1 / 2] << 16));
+            break;
+        default:
+            if(reg < sizeof(regs)) regs[reg / 2] = val;
+            break;
+    }
+}
+
+u32 sdmmc_read32(u16 reg)
+{
+    if(reg == REG_SDFIFO32) return readFifo();
+
+    return sdmmc_read16(reg) | ((u32)sdmmc_read16(reg + 2) << 16);
+}
+
+void sdmmc_write32(u16 reg, u32 val)
+{
+    if(reg == REG_SDFIFO32) writeFifo(val);
+    else
+    {
+        sdmmc_write16(reg, (u16)val);
+        sdmmc_write16(reg + 2, (u16)(val >> 16));
+    }
+}
+
+void waitcycles(u32 us)
+{
+    (void)us;
+}
+
+void cardInit(Card *card, u8 *data, u32 sectors, bool isMmc)
+{
+    memset(card, 0, sizeof(Card));
+
+    card->data = data;
+    card->sectors = sectors;
+    card->isMmc = isMmc;
+    card->isSdhc = !isMmc;
+    card->ccc = isMmc ? 0x0F5 : 0x5B5;
+    card->highSpeed = !isMmc;
+    card->accessNs = isMmc ? 50000 : 100000;
+    card->programNs = isMmc ? 50000 : 20000;
+}
+
+void tmioInsert(u32 port, Card *card)
+{
+    ports[port & 1] = card;
+}
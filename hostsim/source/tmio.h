@@ -0,0 +1,90 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   Model of the SD/MMC controller and of the cards behind it, sdmmc.c talks to it through its register accessors.
+*   Data blocks take as long as they would on the bus at the current clock and bus width (plus the card's own latency),
+*   measured against the host clock, so the payload code can overlap other work with transfers like on the console.
+*/
+
+#pragma once
+
+#include "types.h"
+
+#define TMIO_PORT_SD   0
+#define TMIO_PORT_NAND 1
+
+typedef struct CardStats
+{
+    u32 commands;
+    u32 blocksRead;
+    u32 blocksWritten;
+    u32 readCommands;
+    u32 writeCommands;
+    u32 crcErrors;
+    u32 timeouts;
+    u32 preErasedBlocks; //Sum of the ACMD23 counts
+    u32 strayAcmds;      //ACMDs which didn't follow a successful CMD55
+    u64 busNs;           //Time the bus spent on commands and data
+} CardStats;
+
+typedef struct Card
+{
+    //Contents, in 512-byte sectors
+    u8 *data;
+    u32 sectors;
+    bool isMmc;
+    bool isSdhc;
+    const u32 *cid;         //CID as sdmmc_get_cid returns it (the NAND crypto depends on it), NULL for a made-up one
+
+    //Behaviour, can be changed at any time
+    u32 ccc;                //Command classes reported in the CSD, CMD6 needs the switch class (0x400)
+    bool highSpeed;         //Supports function 1 (high speed) of group 1
+    u32 highSpeedCrcErrors; //Data blocks to corrupt while the clock is at HCLK/2
+    u32 crcErrorDelay;      //Blocks which still go through at HCLK/2 before those
+    u32 failedCmd55s;       //CMD55s to let time out
+    u32 failedWrites;       //Write commands (CMD25) to let time out
+    bool noPreErase;        //ACMD23 times out
+    u32 accessNs;           //From a read command to its first block
+    u32 programNs;          //Busy time after each written block
+
+    //State
+    u32 rca;
+    u32 ocrPolls;
+    bool appCmd;
+    bool selected;
+    bool inHighSpeed;
+
+    CardStats stats;
+} Card;
+
+//Sets up a card with sensible defaults (SD cards: SDHC, high speed capable)
+void cardInit(Card *card, u8 *data, u32 sectors, bool isMmc);
+
+//Puts a card behind a port of the controller (NULL removes it)
+void tmioInsert(u32 port, Card *card);
+
+//Port the last command went to, and the clock divider of the controller
+u32 tmioSelectedPort(void);
+u32 tmioClockDivider(void);
+
+u64 hostNs(void);
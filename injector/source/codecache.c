@@ -0,0 +1,221 @@
+#include <3ds.h>
+#include "codecache.h"
+#include "memory.h"
+#include "strings.h"
+#include "ifile.h"
+
+#define CODE_CACHE_MAGIC   0x43444F43 //"CODC"
+#define CODE_CACHE_ENTRIES 64
+#define CODE_CACHE_BUDGET  0x4000000 //64MB of cached code
+
+typedef struct
+{
+    u64 progId;
+    u32 size;
+    u32 lastUse;
+} CodeCacheEntry;
+
+typedef struct
+{
+    u32 magic;
+    u32 useCounter;
+    CodeCacheEntry entries[CODE_CACHE_ENTRIES];
+} CodeCacheIndex;
+
+typedef struct
+{
+    u32 magic;
+    CodeCacheKey key;
+    u32 size;
+} CodeCacheHeader;
+
+static CodeCacheIndex cacheIndex;
+
+static int fileOpen(IFile *file, const char *path, int flags)
+{
+    FS_Path filePath = {PATH_ASCII, strnlen(path, 255) + 1, path},
+            archivePath = {PATH_EMPTY, 1, (u8 *)""};
+
+    return IFile_Open(file, ARCHIVE_SDMC, archivePath, filePath, flags);
+}
+
+//The cache is only used if the user created /puma/code_cache, as the index can't be created otherwise
+static bool openIndex(IFile *file)
+{
+    if(R_FAILED(fileOpen(file, "/puma/code_cache/index.bin", FS_OPEN_READ | FS_OPEN_WRITE | FS_OPEN_CREATE))) return false;
+
+    u64 total;
+
+    //A new (empty) or truncated index reads short
+    if(R_FAILED(IFile_Read(file, &total, &cacheIndex, sizeof(CodeCacheIndex))) ||
+       total != sizeof(CodeCacheIndex) || cacheIndex.magic != CODE_CACHE_MAGIC)
+    {
+        cacheIndex.magic = CODE_CACHE_MAGIC;
+        cacheIndex.useCounter = 0;
+        for(u32 i = 0; i < CODE_CACHE_ENTRIES; i++) cacheIndex.entries[i].size = 0;
+    }
+
+    return true;
+}
+
+static void closeIndex(IFile *file, bool write)
+{
+    if(write)
+    {
+        u64 total;
+
+        file->pos = 0;
+        IFile_Write(file, &total, &cacheIndex, sizeof(CodeCacheIndex), FS_WRITE_FLUSH);
+    }
+
+    IFile_Close(file);
+}
+
+static CodeCacheEntry *findEntry(u64 progId)
+{
+    for(u32 i = 0; i < CODE_CACHE_ENTRIES; i++)
+        if(cacheIndex.entries[i].size != 0 && cacheIndex.entries[i].progId == progId) return &cacheIndex.entries[i];
+
+    return NULL;
+}
+
+static int openTitleFile(IFile *file, u64 progId, int flags)
+{
+    char path[] = "/puma/code_cache/0000000000000000.bin";
+    progIdToStr(path + 32, progId);
+
+    return fileOpen(file, path, flags);
+}
+
+//The loader can't delete files, evicted entries are truncated instead
+static void evictEntry(CodeCacheEntry *entry)
+{
+    IFile file;
+
+    if(R_SUCCEEDED(openTitleFile(&file, entry->progId, FS_OPEN_WRITE)))
+    {
+        IFile_SetSize(&file, 0);
+        IFile_Close(&file);
+    }
+
+    entry->progId = 0;
+    entry->size = 0;
+}
+
+//FNV-1a over words, only meant to tell versions of a title apart
+u32 codeCacheHash(const u8 *data, u32 size)
+{
+    const u32 *words = (const u32 *)data;
+    u32 hash = 0x811C9DC5;
+
+    for(u32 i = 0; i < size / 4; i++) hash = (hash ^ words[i]) * 0x01000193;
+    for(u32 i = size & ~3; i < size; i++) hash = (hash ^ data[i]) * 0x01000193;
+
+    return hash;
+}
+
+bool codeCacheLoad(u64 progId, const CodeCacheKey *key, u8 *code, u32 maxSize)
+{
+    IFile indexFile;
+
+    if(!openIndex(&indexFile)) return false;
+
+    CodeCacheEntry *entry = findEntry(progId);
+    bool hit = false;
+
+    if(entry != NULL && entry->size <= maxSize)
+    {
+        IFile file;
+
+        if(R_SUCCEEDED(openTitleFile(&file, progId, FS_OPEN_READ)))
+        {
+            CodeCacheHeader header;
+            u64 total;
+
+            hit = R_SUCCEEDED(IFile_Read(&file, &total, &header, sizeof(CodeCacheHeader))) && total == sizeof(CodeCacheHeader) &&
+                  header.magic == CODE_CACHE_MAGIC && header.size == entry->size && memcmp(&header.key, key, sizeof(CodeCacheKey)) == 0 &&
+                  R_SUCCEEDED(IFile_Read(&file, &total, code, header.size)) && total == header.size;
+
+            IFile_Close(&file);
+        }
+
+        //Stale (title updated, CFW or options changed) or damaged, let codeCacheStore overwrite it
+        if(hit) entry->lastUse = ++cacheIndex.useCounter;
+    }
+
+    closeIndex(&indexFile, hit);
+
+    return hit;
+}
+
+void codeCacheStore(u64 progId, const CodeCacheKey *key, const u8 *code, u32 size)
+{
+    if(size == 0 || size > CODE_CACHE_BUDGET) return;
+
+    IFile indexFile;
+
+    if(!openIndex(&indexFile)) return;
+
+    CodeCacheEntry *entry = findEntry(progId);
+    if(entry != NULL) entry->size = 0;
+
+    //Evict the least recently used titles until the new code fits in the budget and in the index
+    while(true)
+    {
+        u32 usedSize = 0;
+        CodeCacheEntry *lru = NULL;
+
+        if(entry == NULL) for(u32 i = 0; i < CODE_CACHE_ENTRIES; i++) if(cacheIndex.entries[i].size == 0)
+        {
+            entry = &cacheIndex.entries[i];
+            break;
+        }
+
+        for(u32 i = 0; i < CODE_CACHE_ENTRIES; i++)
+        {
+            CodeCacheEntry *cur = &cacheIndex.entries[i];
+            if(cur->size == 0) continue;
+
+            usedSize += cur->size;
+            if(lru == NULL || cur->lastUse < lru->lastUse) lru = cur;
+        }
+
+        if(entry != NULL && usedSize + size <= CODE_CACHE_BUDGET) break;
+
+        evictEntry(lru);
+    }
+
+    IFile file;
+
+    if(R_SUCCEEDED(openTitleFile(&file, progId, FS_OPEN_WRITE | FS_OPEN_CREATE)))
+    {
+        CodeCacheHeader header = {CODE_CACHE_MAGIC, *key, size};
+        u64 total;
+
+        //Write the header last, so that an interrupted store never looks valid
+        header.magic = 0;
+
+        bool stored = R_SUCCEEDED(IFile_SetSize(&file, sizeof(CodeCacheHeader) + size)) &&
+                      R_SUCCEEDED(IFile_Write(&file, &total, &header, sizeof(CodeCacheHeader), 0)) &&
+                      R_SUCCEEDED(IFile_Write(&file, &total, code, size, 0)) && total == size;
+
+        if(stored)
+        {
+            header.magic = CODE_CACHE_MAGIC;
+            file.pos = 0;
+            stored = R_SUCCEEDED(IFile_Write(&file, &total, &header, sizeof(CodeCacheHeader), FS_WRITE_FLUSH));
+        }
+
+        if(!stored) IFile_SetSize(&file, 0);
+        IFile_Close(&file);
+
+        if(stored)
+        {
+            entry->progId = progId;
+            entry->size = size;
+            entry->lastUse = ++cacheIndex.useCounter;
+        }
+    }
+
+    closeIndex(&indexFile, true);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <3ds/types.h>
+
+//Everything a cached .code depends on besides the title ID
+typedef struct
+{
+    u32 codeFileSize;
+    u32 remasterVersion;
+    u32 cfwCommit;
+    u32 patchesConfig;
+    u32 codeHash;        //Of the .code as read from the title: an update changes it even with the same size and remaster version
+} CodeCacheKey;
+
+u32 codeCacheHash(const u8 *data, u32 size);
+
+bool codeCacheLoad(u64 progId, const CodeCacheKey *key, u8 *code, u32 maxSize);
+void codeCacheStore(u64 progId, const CodeCacheKey *key, const u8 *code, u32 size);
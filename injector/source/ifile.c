@@ -2,10 +2,13 @@
 #include "ifile.h"
 #include "fsldr.h"
 
+u32 g_ifile_ipc_count;
+
 Result IFile_Open(IFile *file, FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, u32 flags)
 {
   Result res;
 
+  g_ifile_ipc_count++;
   res = FSLDR_OpenFileDirectly(&file->handle, archiveId, archivePath, filePath, flags, 0);
   file->pos = 0;
   file->size = 0;
@@ -14,6 +17,7 @@ Result IFile_Open(IFile *file, FS_ArchiveID archiveId, FS_Path archivePath, FS_P
 
 Result IFile_Close(IFile *file)
 {
+  g_ifile_ipc_count++;
   return FSFILE_Close(file->handle);
 }
 
@@ -21,6 +25,7 @@ Result IFile_GetSize(IFile *file, u64 *size)
 {
   Result res;
 
+  g_ifile_ipc_count++;
   res = FSFILE_GetSize(file->handle, size);
   file->size = *size;
   return res;
@@ -45,6 +50,7 @@ Result IFile_Read(IFile *file, u64 *total, void *buffer, u32 len)
   left = len;
   while (1)
   {
+    g_ifile_ipc_count++;
     res = FSFILE_Read(file->handle, &read, file->pos, buf, left);
     if (R_FAILED(res))
     {
@@ -53,7 +59,7 @@ Result IFile_Read(IFile *file, u64 *total, void *buffer, u32 len)
 
     cur += read;
     file->pos += read;
-    if (read == left)
+    if (read == left || read == 0) // done or end of file
     {
       break;
     }
@@ -63,4 +69,53 @@ Result IFile_Read(IFile *file, u64 *total, void *buffer, u32 len)
 
   *total = cur;
   return res;
+}
+
+Result IFile_Write(IFile *file, u64 *total, const void *buffer, u32 len, u32 flags)
+{
+  u32 written;
+  Result res;
+
+  g_ifile_ipc_count++;
+  res = FSFILE_Write(file->handle, &written, file->pos, buffer, len, flags);
+  if (R_SUCCEEDED(res))
+  {
+    file->pos += written;
+    *total = written;
+  }
+  else
+  {
+    *total = 0;
+  }
+  return res;
+}
+
+Result IFile_SetSize(IFile *file, u64 size)
+{
+  Result res;
+
+  g_ifile_ipc_count++;
+  res = FSFILE_SetSize(file->handle, size);
+  if (R_SUCCEEDED(res))
+  {
+    file->size = size;
+  }
+  return res;
+}
+
+Result IFile_ReadFile(FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, void *buffer, u32 len, u64 *total)
+{
+  IFile file;
+  Result res;
+
+  *total = 0;
+  res = IFile_Open(&file, archiveId, archivePath, filePath, FS_OPEN_READ);
+  if (R_FAILED(res))
+  {
+    return res;
+  }
+
+  res = IFile_Read(&file, total, buffer, len);
+  IFile_Close(&file);
+  return res;
 }
\ No newline at end of file
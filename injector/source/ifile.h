@@ -9,7 +9,16 @@ typedef struct
   u64 size;
 } IFile;
 
+// FS requests made through this API, for the loader metrics
+extern u32 g_ifile_ipc_count;
+
 Result IFile_Open(IFile *file, FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, u32 flags);
 Result IFile_Close(IFile *file);
 Result IFile_GetSize(IFile *file, u64 *size);
-Result IFile_Read(IFile *file, u64 *total, void *buffer, u32 len);
\ No newline at end of file
+Result IFile_Read(IFile *file, u64 *total, void *buffer, u32 len);
+Result IFile_Write(IFile *file, u64 *total, const void *buffer, u32 len, u32 flags);
+Result IFile_SetSize(IFile *file, u64 size);
+
+// Open, read up to len bytes and close in 3 requests. Pass a buffer one byte bigger than the biggest
+// accepted file and check *total to reject oversized files without an extra GetSize request
+Result IFile_ReadFile(FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, void *buffer, u32 len, u64 *total);
\ No newline at end of file
@@ -7,8 +7,12 @@
 #include "fsreg.h"
 #include "pxipm.h"
 #include "srvsys.h"
+#include "metrics.h"
+#include "codecache.h"
+#include "sessions.h"
 
-#define MAX_SESSIONS 1
+// compressed .code is read in chunks of this size from the end, decompressing as they arrive
+#define CODE_CHUNK_SIZE 0x20000
 
 const char CODE_PATH[] = {0x01, 0x00, 0x00, 0x00, 0x2E, 0x63, 0x6F, 0x64, 0x65, 0x00, 0x00, 0x00};
 
@@ -23,13 +27,123 @@ typedef struct
   u32 total_size;
 } prog_addrs_t;
 
-static Handle g_handles[MAX_SESSIONS+2];
-static int g_active_handles;
+typedef struct
+{
+  IFile *file;
+  u8 *base;
+  u32 size;
+  volatile u32 low;  // offset of the lowest byte read so far
+  Result res;
+  u64 ticks;
+  Handle event;      // signaled after every chunk
+  Handle thread;
+} code_stream_t;
+
+static session_list_t g_sessions;
 static u64 g_cached_prog_handle;
 static exheader_header g_exheader;
 static char g_ret_buf[1024];
+static loader_metrics_t g_metrics;
+
+static u8 g_stream_stack[0x1000] __attribute__((aligned(8)));
+
+static inline void metrics_add(int phase, u64 ticks)
+{
+  g_metrics.phase_ticks[phase] += ticks;
+  if (ticks > g_metrics.phase_max_ticks[phase])
+  {
+    g_metrics.phase_max_ticks[phase] = ticks;
+  }
+}
+
+static inline void metrics_record(int phase, u64 start)
+{
+  metrics_add(phase, svcGetSystemTick() - start);
+}
+
+static void code_stream_thread(void *arg)
+{
+  code_stream_t *stream;
+  u32 offset;
+  u32 len;
+  u64 total;
+  u64 start;
+
+  stream = (code_stream_t *)arg;
+  start = svcGetSystemTick();
+  offset = stream->size;
+  while (offset > 0)
+  {
+    len = offset > CODE_CHUNK_SIZE ? CODE_CHUNK_SIZE : offset;
+    offset -= len;
+    stream->file->pos = offset;
+    stream->res = IFile_Read(stream->file, &total, stream->base + offset, len);
+    if (R_SUCCEEDED(stream->res) && total != len)
+    {
+      stream->res = MAKERESULT(RL_PERMANENT, RS_INVALIDSTATE, RM_APPLICATION, RD_NO_DATA);
+    }
+    if (R_FAILED(stream->res))
+    {
+      offset = 0; // release the decompressor, load_code breaks on the error
+    }
+    stream->low = offset;
+    svcSignalEvent(stream->event);
+  }
+  stream->ticks = svcGetSystemTick() - start;
+  svcExitThread();
+}
+
+static Result code_stream_start(code_stream_t *stream, IFile *file, u8 *base, u32 size)
+{
+  Result res;
+  s32 prio;
+
+  stream->file = file;
+  stream->base = base;
+  stream->size = size;
+  stream->low = size;
+  stream->res = 0;
+  stream->ticks = 0;
+
+  res = svcCreateEvent(&stream->event, RESET_ONESHOT);
+  if (R_FAILED(res))
+  {
+    return res;
+  }
+
+  // the reader runs above us so that it can queue the next chunk as soon as FS answers
+  svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+  res = svcCreateThread(&stream->thread, code_stream_thread, (u32)stream, (u32 *)(g_stream_stack + sizeof(g_stream_stack)), prio - 1, -2);
+  if (R_FAILED(res))
+  {
+    res = svcCreateThread(&stream->thread, code_stream_thread, (u32)stream, (u32 *)(g_stream_stack + sizeof(g_stream_stack)), prio, -2);
+  }
+  if (R_FAILED(res))
+  {
+    svcCloseHandle(stream->event);
+  }
+  return res;
+}
+
+static Result code_stream_finish(code_stream_t *stream)
+{
+  svcWaitSynchronization(stream->thread, U64_MAX);
+  svcCloseHandle(stream->thread);
+  svcCloseHandle(stream->event);
+  return stream->res;
+}
+
+static inline int code_stream_wait(code_stream_t *stream, u32 offset)
+{
+  while (stream->low > offset)
+  {
+    svcWaitSynchronization(stream->event, U64_MAX);
+  }
+  return R_SUCCEEDED(stream->res);
+}
 
-static int lzss_decompress(u8 *end)
+// returns by how many bytes the code grew; with a stream, waits for each part of the input to be read
+static u32 lzss_decompress(u8 *end, code_stream_t *stream)
 {
   unsigned int v1; // r1@2
   u8 *v2; // r2@2
@@ -45,17 +159,27 @@ static int lzss_decompress(u8 *end)
   int v14; // t1@8
   unsigned int v15; // r7@8
   int v16; // r12@8
-  int ret;
+  u8 v17;
+  u32 ret;
 
   ret = 0;
   if ( end )
   {
+    if ( stream && !code_stream_wait(stream, stream->size - 8) )
+      return 0;
+    ret = *((u32 *)end - 1);
     v1 = *((u32 *)end - 2);
     v2 = &end[*((u32 *)end - 1)];
     v3 = &end[-(v1 >> 24)];
     v4 = &end[-(v1 & 0xFFFFFF)];
+    if ( stream && !code_stream_wait(stream, v3 - stream->base) )
+      return ret;
     while ( v3 > v4 )
     {
+      // a flag byte and its 8 blocks take at most 17 bytes
+      if ( stream && (u32)(v3 - stream->base) < stream->low + 17
+           && !code_stream_wait(stream, (u32)(v3 - stream->base) > 17 ? (u32)(v3 - stream->base) - 17 : 0) )
+        return ret;
       v6 = *(v3-- - 1);
       v5 = v6;
       v7 = 8;
@@ -74,8 +198,8 @@ static int lzss_decompress(u8 *end)
           v16 = v12 + 32;
           do
           {
-            ret = v2[v15];
-            *(v2-- - 1) = ret;
+            v17 = v2[v15];
+            *(v2-- - 1) = v17;
             v16 -= 16;
           }
           while ( !(v16 < 0) );
@@ -83,7 +207,6 @@ static int lzss_decompress(u8 *end)
         else
         {
           v9 = *(v3-- - 1);
-          ret = v9;
           *(v2-- - 1) = v9;
         }
         v5 *= 2;
@@ -114,6 +237,11 @@ static Result load_code(u64 progid, prog_addrs_t *shared, u64 prog_handle, int i
   Result res;
   u64 size;
   u64 total;
+  u64 start;
+  u32 code_size;
+  int use_cache;
+  CodeCacheKey cache_key;
+  code_stream_t stream;
 
   archivePath.type = PATH_BINARY;
   archivePath.data = &prog_handle;
@@ -141,22 +269,71 @@ static Result load_code(u64 progid, prog_addrs_t *shared, u64 prog_handle, int i
     return 0xC900464F;
   }
 
-  // read code
-  res = IFile_Read(&file, &total, (void *)shared->text_addr, size);
-  IFile_Close(&file); // done reading
-  if (R_FAILED(res))
+  // the decompressed .code cache is keyed on the .code as read, so it is read in full before decompressing
+  use_cache = getCodeCacheConfig(progid, &cache_key.cfwCommit, &cache_key.patchesConfig);
+
+  code_size = size;
+  if (!use_cache && is_compressed && size > CODE_CHUNK_SIZE && R_SUCCEEDED(code_stream_start(&stream, &file, (u8 *)shared->text_addr, size)))
   {
-    svcBreak(USERBREAK_ASSERT);
+    // read and decompress at the same time, the decompression time includes waiting for reads
+    start = svcGetSystemTick();
+    code_size += lzss_decompress((u8 *)shared->text_addr + size, &stream);
+    res = code_stream_finish(&stream);
+    IFile_Close(&file); // done reading
+    if (R_FAILED(res))
+    {
+      svcBreak(USERBREAK_ASSERT);
+    }
+    metrics_record(METRIC_DECOMPRESS, start);
+    metrics_add(METRIC_READ, stream.ticks);
+    g_metrics.code_bytes += size;
   }
-
-  // decompress
-  if (is_compressed)
+  else
   {
-    lzss_decompress((u8 *)shared->text_addr + size);
+    // read code
+    start = svcGetSystemTick();
+    res = IFile_Read(&file, &total, (void *)shared->text_addr, size);
+    IFile_Close(&file); // done reading
+    if (R_FAILED(res))
+    {
+      svcBreak(USERBREAK_ASSERT);
+    }
+    metrics_record(METRIC_READ, start);
+    g_metrics.code_bytes += total;
+
+    // try the cache
+    if (use_cache)
+    {
+      cache_key.codeFileSize = size;
+      cache_key.remasterVersion = g_exheader.codesetinfo.flags.remasterversion[0] | (g_exheader.codesetinfo.flags.remasterversion[1] << 8);
+      cache_key.codeHash = codeCacheHash((u8 *)shared->text_addr, size);
+      start = svcGetSystemTick();
+      if (codeCacheLoad(progid, &cache_key, (u8 *)shared->text_addr, shared->total_size << 12))
+      {
+        metrics_record(METRIC_READ, start);
+        g_metrics.code_cache_hits++;
+        return 0;
+      }
+    }
+
+    // decompress
+    if (is_compressed)
+    {
+      start = svcGetSystemTick();
+      code_size += lzss_decompress((u8 *)shared->text_addr + size, NULL);
+      metrics_record(METRIC_DECOMPRESS, start);
+    }
   }
 
   // patch
+  start = svcGetSystemTick();
   patchCode(progid, (u8 *)shared->text_addr, shared->total_size << 12);
+  metrics_record(METRIC_PATCH, start);
+
+  if (use_cache && code_size <= (shared->total_size << 12))
+  {
+    codeCacheStore(progid, &cache_key, (u8 *)shared->text_addr, code_size);
+  }
 
   return 0;
 }
@@ -198,11 +375,14 @@ static Result loader_LoadProcess(Handle *process, u64 prog_handle)
   CodeSetInfo codesetinfo;
   u32 data_mem_size;
   u64 progid;
+  u64 start;
 
   // make sure the cached info corrosponds to the current prog_handle
   if (g_cached_prog_handle != prog_handle)
   {
+    start = svcGetSystemTick();
     res = loader_GetProgramInfo(&g_exheader, prog_handle);
+    metrics_record(METRIC_EXHEADER, start);
     g_cached_prog_handle = prog_handle;
     if (res < 0)
     {
@@ -255,13 +435,18 @@ static Result loader_LoadProcess(Handle *process, u64 prog_handle)
     codesetinfo.rw_addr = vaddr.data_addr;
     codesetinfo.rw_size = vaddr.data_size;
     codesetinfo.rw_size_total = data_mem_size;
+    start = svcGetSystemTick();
     res = svcCreateCodeSet(&codeset, &codesetinfo, (void *)shared_addr.text_addr, (void *)shared_addr.ro_addr, (void *)shared_addr.data_addr);
+    metrics_record(METRIC_CODESET, start);
     if (res >= 0)
     {
+      start = svcGetSystemTick();
       res = svcCreateProcess(process, codeset, g_exheader.arm11kernelcaps.descriptors, count);
+      metrics_record(METRIC_CREATE_PROCESS, start);
       svcCloseHandle(codeset);
       if (res >= 0)
       {
+        g_metrics.load_count++;
         return 0;
       }
     }
@@ -354,10 +539,12 @@ static void handle_commands(void)
   int res;
   Handle handle;
   u64 prog_handle;
+  u32 i;
 
   cmdbuf = getThreadCommandBuffer();
   cmdid = cmdbuf[0] >> 16;
   res = 0;
+  g_metrics.command_count[cmdid >= 1 && cmdid <= 4 ? cmdid : (cmdid == LOADER_GET_METRICS ? 5 : 0)]++;
   switch (cmdid)
   {
     case 1: // LoadProcess
@@ -411,6 +598,24 @@ static void handle_commands(void)
       cmdbuf[3] = (u32) &g_ret_buf;
       break;
     }
+    case LOADER_GET_METRICS: // GetMetrics (custom)
+    {
+      g_metrics.fs_requests = g_ifile_ipc_count;
+      memcpy(&g_ret_buf, &g_metrics, sizeof(loader_metrics_t));
+      if (cmdbuf[1])
+      {
+        for (i = 0; i < sizeof(loader_metrics_t) / 4; i++)
+        {
+          ((u32 *)&g_metrics)[i] = 0;
+        }
+        g_ifile_ipc_count = 0;
+      }
+      cmdbuf[0] = 0x1000042;
+      cmdbuf[1] = 0;
+      cmdbuf[2] = (sizeof(loader_metrics_t) << 14) | 2;
+      cmdbuf[3] = (u32) &g_ret_buf;
+      break;
+    }
     default: // error
     {
       cmdbuf[0] = 0x40;
@@ -482,14 +687,13 @@ int main()
   Handle *srv_handle;
   Handle *notification_handle;
   s32 index;
-  int i;
   int term_request;
   u32* cmdbuf;
 
   ret = 0;
 
-  srv_handle = &g_handles[1];
-  notification_handle = &g_handles[0];
+  srv_handle = &g_sessions.handles[SESSION_PORT];
+  notification_handle = &g_sessions.handles[SESSION_NOTIFICATION];
 
   if (R_FAILED(srvSysRegisterService(srv_handle, "Loader", MAX_SESSIONS)))
   {
@@ -501,7 +705,7 @@ int main()
     svcBreak(USERBREAK_ASSERT);
   }
 
-  g_active_handles = 2;
+  sessions_init(&g_sessions, MAX_SESSIONS);
   g_cached_prog_handle = 0;
   index = 1;
 
@@ -514,7 +718,7 @@ int main()
       cmdbuf = getThreadCommandBuffer();
       cmdbuf[0] = 0xFFFF0000;
     }
-    ret = svcReplyAndReceive(&index, g_handles, g_active_handles, reply_target);
+    ret = svcReplyAndReceive(&index, g_sessions.handles, g_sessions.count, reply_target);
 
     if (R_FAILED(ret))
     {
@@ -523,18 +727,13 @@ int main()
       {
         if (index == -1)
         {
-          for (i = 2; i < MAX_SESSIONS+2; i++)
-          {
-            if (g_handles[i] == reply_target)
-            {
-              index = i;
-              break;
-            }
-          }
+          index = sessions_find(&g_sessions, reply_target);
+        }
+        if (index >= SESSION_FIRST)
+        {
+          svcCloseHandle(g_sessions.handles[index]);
+          sessions_remove(&g_sessions, index);
         }
-        svcCloseHandle(g_handles[index]);
-        g_handles[index] = g_handles[g_active_handles-1];
-        g_active_handles--;
         reply_target = 0;
       }
       else 
@@ -548,7 +747,7 @@ int main()
       reply_target = 0;
       switch (index)
       {
-        case 0: // notification
+        case SESSION_NOTIFICATION:
         {
           if (R_FAILED(should_terminate(&term_request)))
           {
@@ -556,18 +755,13 @@ int main()
           }
           break;
         }
-        case 1: // new session
+        case SESSION_PORT: // new session
         {
           if (R_FAILED(svcAcceptSession(&handle, *srv_handle)))
           {
             svcBreak(USERBREAK_ASSERT);
           }
-          if (g_active_handles < MAX_SESSIONS+2)
-          {
-            g_handles[g_active_handles] = handle;
-            g_active_handles++;
-          }
-          else
+          if (!sessions_add(&g_sessions, handle))
           {
             svcCloseHandle(handle);
           }
@@ -576,12 +770,13 @@ int main()
         default: // session
         {
           handle_commands();
-          reply_target = g_handles[index];
+          reply_target = g_sessions.handles[index];
+          sessions_served(&g_sessions, index);
           break;
         }
       }
     }
-  } while (!term_request || g_active_handles != 2);
+  } while (!term_request || g_sessions.count != SESSION_FIRST);
 
   srvSysUnregisterService("Loader");
   svcCloseHandle(*srv_handle);
@@ -45,5 +45,34 @@ u8 *memsearch(u8 *startPos, const void *pattern, u32 size, u32 patternSize)
         j += table[c];
     }
 
+    return NULL;
+}
+
+//Builds the Boyer-Moore Horspool skip table for a pattern shorter than 256 bytes, so that it can be reused
+void memsearchTable(u8 *table, const void *pattern, u32 patternSize)
+{
+    const u8 *patternc = (const u8 *)pattern;
+
+    for(u32 i = 0; i < 256; i++)
+        table[i] = (u8)patternSize;
+    for(u32 i = 0; i < patternSize - 1; i++)
+        table[patternc[i]] = (u8)(patternSize - i - 1);
+}
+
+u8 *memsearchWithTable(u8 *startPos, const void *pattern, u32 size, u32 patternSize, const u8 *table)
+{
+    const u8 *patternc = (const u8 *)pattern;
+
+    if(size < patternSize) return NULL;
+
+    u32 j = 0;
+    while(j <= size - patternSize)
+    {
+        u8 c = startPos[j + patternSize - 1];
+        if(patternc[patternSize - 1] == c && memcmp(pattern, startPos + j, patternSize - 1) == 0)
+            return startPos + j;
+        j += table[c];
+    }
+
     return NULL;
 }
\ No newline at end of file
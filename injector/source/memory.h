@@ -4,4 +4,6 @@
 
 void memcpy(void *dest, const void *src, u32 size);
 int memcmp(const void *buf1, const void *buf2, u32 size);
-u8 *memsearch(u8 *startPos, const void *pattern, u32 size, u32 patternSize);
\ No newline at end of file
+u8 *memsearch(u8 *startPos, const void *pattern, u32 size, u32 patternSize);
+void memsearchTable(u8 *table, const void *pattern, u32 patternSize);
+u8 *memsearchWithTable(u8 *startPos, const void *pattern, u32 size, u32 patternSize, const u8 *table);
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <3ds/types.h>
+
+/* Loader command 0x100 (GetMetrics): cmdbuf[1] != 0 resets the counters after reading them.
+   The reply is a static buffer (id 0) holding a loader_metrics_t */
+#define LOADER_GET_METRICS 0x100
+
+enum
+{
+  METRIC_EXHEADER = 0,    // loader_GetProgramInfo on a cache miss
+  METRIC_READ,            // IFile_Read of .code, or of its cached copy
+  METRIC_DECOMPRESS,      // lzss_decompress, including waits for chunked reads
+  METRIC_PATCH,           // patchCode
+  METRIC_CODESET,         // svcCreateCodeSet
+  METRIC_CREATE_PROCESS,  // svcCreateProcess
+  METRIC_PHASE_COUNT
+};
+
+typedef struct
+{
+  u32 command_count[6];                   // 0: unknown, 1-4: official commands, 5: GetMetrics
+  u32 load_count;                         // successful LoadProcess calls
+  u32 code_bytes;                         // .code bytes read from the filesystem
+  u64 phase_ticks[METRIC_PHASE_COUNT];    // svcGetSystemTick units, summed over all loads
+  u64 phase_max_ticks[METRIC_PHASE_COUNT];
+  u32 code_cache_hits;                    // loads served from /puma/code_cache
+  u32 fs_requests;                        // FS IPC requests made through IFile
+} loader_metrics_t;
@@ -7,15 +7,19 @@
 
 static CFWInfo info;
 
-static void patchMemory(u8 *start, u32 size, const void *pattern, u32 patSize, int offset, const void *replace, u32 repSize, u32 count)
+static void patchMemoryWithTable(u8 *start, u32 size, const void *pattern, u32 patSize, int offset, const void *replace, u32 repSize, u32 count, const u8 *table)
 {
+    u8 *const base = start,
+       *const end = start + size;
+
     for(u32 i = 0; i < count; i++)
     {
-        u8 *found = memsearch(start, pattern, size, patSize);
+        u8 *found = memsearchWithTable(start, pattern, size, patSize, table);
 
         if(found == NULL) break;
 
-        memcpy(found + offset, replace, repSize);
+        //Patches from SD can't be trusted to stay in bounds
+        if(found + offset >= base && found + offset + repSize <= end) memcpy(found + offset, replace, repSize);
 
         u32 at = (u32)(found - start);
 
@@ -26,6 +30,14 @@ static void patchMemory(u8 *start, u32 size, const void *pattern, u32 patSize, i
     }
 }
 
+static void patchMemory(u8 *start, u32 size, const void *pattern, u32 patSize, int offset, const void *replace, u32 repSize, u32 count)
+{
+    u8 table[256];
+
+    memsearchTable(table, pattern, patSize);
+    patchMemoryWithTable(start, size, pattern, patSize, offset, replace, repSize, count, table);
+}
+
 static int fileOpen(IFile *file, FS_ArchiveID archiveId, const char *path, int flags)
 {
     FS_Path filePath = {PATH_ASCII, strnlen(path, 255) + 1, path},
@@ -34,6 +46,14 @@ static int fileOpen(IFile *file, FS_ArchiveID archiveId, const char *path, int f
     return IFile_Open(file, archiveId, archivePath, filePath, flags);
 }
 
+static int fileRead(const char *path, void *buffer, u32 len, u64 *total)
+{
+    FS_Path filePath = {PATH_ASCII, strnlen(path, 255) + 1, path},
+            archivePath = {PATH_EMPTY, 1, (u8 *)""};
+
+    return IFile_ReadFile(ARCHIVE_SDMC, archivePath, filePath, buffer, len, total);
+}
+
 static void loadCFWInfo(void)
 {
     static bool infoLoaded = false;
@@ -75,53 +95,42 @@ static void loadCustomVerString(u16 *out, u32 *verStringSize, u32 currentNand)
                                    "/puma/customversion_emu3.txt",
                                    "/puma/customversion_emu4.txt" };
 
-    IFile file;
+    //One more byte than the biggest accepted file, to detect bigger ones
+    u8 buf[63];
+    u64 fileSize;
 
-    if(R_SUCCEEDED(fileOpen(&file, ARCHIVE_SDMC, paths[currentNand], FS_OPEN_READ)))
+    if(R_SUCCEEDED(fileRead(paths[currentNand], buf, sizeof(buf), &fileSize)) && fileSize <= 62)
     {
-        u64 fileSize;
+        static const u8 bom[] = {0xEF, 0xBB, 0xBF};
+        u32 finalSize = 0;
 
-        if(R_SUCCEEDED(IFile_GetSize(&file, &fileSize)) && fileSize <= 62)
+        //Convert from UTF-8 to UTF-16 (Nintendo doesn't support 4-byte UTF-16, so 4-byte UTF-8 is unsupported)
+        for(u32 increase, fileSizeTmp = (u32)fileSize, i = (fileSizeTmp > 2 && memcmp(buf, bom, 3) == 0) ? 3 : 0;
+            i < fileSizeTmp && finalSize < 19; i += increase, finalSize++)
         {
-            u8 buf[fileSize];
-            u64 total;
-
-            if(R_SUCCEEDED(IFile_Read(&file, &total, buf, fileSize)))
+            if((buf[i] & 0x80) == 0 && !(buf[i] == 0xA || buf[i] == 0xD))
             {
-                static const u8 bom[] = {0xEF, 0xBB, 0xBF};
-                u32 finalSize = 0;
-
-                //Convert from UTF-8 to UTF-16 (Nintendo doesn't support 4-byte UTF-16, so 4-byte UTF-8 is unsupported)
-                for(u32 increase, fileSizeTmp = (u32)fileSize, i = (fileSizeTmp > 2 && memcmp(buf, bom, 3) == 0) ? 3 : 0;
-                    i < fileSizeTmp && finalSize < 19; i += increase, finalSize++)
-                {
-                    if((buf[i] & 0x80) == 0 && !(buf[i] == 0xA || buf[i] == 0xD))
-                    {
-                        increase = 1;
-                        out[finalSize] = (u16)buf[i];
-                    }
-                    else if((buf[i] & 0xE0) == 0xC0 && i + 1 < fileSizeTmp && (buf[i + 1] & 0xC0) == 0x80)
-                    {
-                        increase = 2;
-                        out[finalSize] = (u16)(((buf[i] & 0x1F) << 6) | (buf[i + 1] & 0x3F));
-                    }
-                    else if((buf[i] & 0xF0) == 0xE0 && i + 2 < fileSizeTmp && (buf[i + 1] & 0xC0) == 0x80 && (buf[i + 2] & 0xC0) == 0x80)
-                    {
-                        increase = 3;
-                        out[finalSize] = (u16)(((buf[i] & 0xF) << 12) | ((buf[i + 1] & 0x3F) << 6) | (buf[i + 2] & 0x3F));
-                    }
-                    else break;
-                }
-
-                if(finalSize > 0)
-                {
-                    if(finalSize > 5 && finalSize < 19) out[finalSize++] = 0;
-                    *verStringSize = finalSize * 2;
-                }
+                increase = 1;
+                out[finalSize] = (u16)buf[i];
+            }
+            else if((buf[i] & 0xE0) == 0xC0 && i + 1 < fileSizeTmp && (buf[i + 1] & 0xC0) == 0x80)
+            {
+                increase = 2;
+                out[finalSize] = (u16)(((buf[i] & 0x1F) << 6) | (buf[i + 1] & 0x3F));
+            }
+            else if((buf[i] & 0xF0) == 0xE0 && i + 2 < fileSizeTmp && (buf[i + 1] & 0xC0) == 0x80 && (buf[i + 2] & 0xC0) == 0x80)
+            {
+                increase = 3;
+                out[finalSize] = (u16)(((buf[i] & 0xF) << 12) | ((buf[i + 1] & 0x3F) << 6) | (buf[i + 2] & 0x3F));
             }
+            else break;
         }
 
-        IFile_Close(&file);
+        if(finalSize > 0)
+        {
+            if(finalSize > 5 && finalSize < 19) out[finalSize++] = 0;
+            *verStringSize = finalSize * 2;
+        }
     }
 }
 
@@ -157,44 +166,32 @@ static void loadTitleLocaleConfig(u64 progId, u8 *regionId, u8 *languageId)
     char path[] = "/puma/locales/0000000000000000.txt";
     progIdToStr(path + 29, progId);
 
-    IFile file;
+    char buf[9];
+    u64 fileSize;
 
-    if(R_SUCCEEDED(fileOpen(&file, ARCHIVE_SDMC, path, FS_OPEN_READ)))
+    if(R_SUCCEEDED(fileRead(path, buf, sizeof(buf), &fileSize)) && fileSize > 5 && fileSize < 9)
     {
-        u64 fileSize;
-
-        if(R_SUCCEEDED(IFile_GetSize(&file, &fileSize)) && fileSize > 5 && fileSize < 9)
+        for(u32 i = 0; i < 7; i++)
         {
-            char buf[fileSize];
-            u64 total;
+            static const char *regions[] = {"JPN", "USA", "EUR", "AUS", "CHN", "KOR", "TWN"};
 
-            if(R_SUCCEEDED(IFile_Read(&file, &total, buf, fileSize)))
+            if(memcmp(buf, regions[i], 3) == 0)
             {
-                for(u32 i = 0; i < 7; i++)
-                {
-                    static const char *regions[] = {"JPN", "USA", "EUR", "AUS", "CHN", "KOR", "TWN"};
-
-                    if(memcmp(buf, regions[i], 3) == 0)
-                    {
-                        *regionId = (u8)i;
-                        break;
-                    }
-                }
+                *regionId = (u8)i;
+                break;
+            }
+        }
 
-                for(u32 i = 0; i < 12; i++)
-                {
-                    static const char *languages[] = {"JP", "EN", "FR", "DE", "IT", "ES", "ZH", "KO", "NL", "PT", "RU", "TW"};
+        for(u32 i = 0; i < 12; i++)
+        {
+            static const char *languages[] = {"JP", "EN", "FR", "DE", "IT", "ES", "ZH", "KO", "NL", "PT", "RU", "TW"};
 
-                    if(memcmp(buf + 4, languages[i], 2) == 0)
-                    {
-                        *languageId = (u8)i;
-                        break;
-                    }
-                }
+            if(memcmp(buf + 4, languages[i], 2) == 0)
+            {
+                *languageId = (u8)i;
+                break;
             }
         }
-
-        IFile_Close(&file);
     }
 }
 
@@ -204,16 +201,11 @@ static int loadCountryConfig(char *countryString)
        If it exists it should contain, for example, "GB" */
     char path[] = "/puma/locales/country.txt";
 
-    IFile file;
-    Result ret = fileOpen(&file, ARCHIVE_SDMC, path, FS_OPEN_READ);
+    u64 total;
+    Result ret = fileRead(path, countryString, 2, &total);
     if(R_SUCCEEDED(ret))
     {
-        u64 total;
-
-        ret = IFile_Read(&file, &total, countryString, 2);
-        IFile_Close(&file);
-
-        if(!R_SUCCEEDED(ret) || total < 2) return -1;
+        if(total < 2) return -1;
 		return 0;
 	}
     return ret;
@@ -330,77 +322,297 @@ static void patchCfgGetRegion(u8 *code, u32 size, u8 regionId, u32 CFGUHandleOff
     }
 }
 
-void patchCode(u64 progId, u8 *code, u32 size)
+enum patchGates
 {
-    loadCFWInfo();
+    PATCH_ALWAYS = 0,
+    PATCH_REGIONFREE,
+    PATCH_PREVENTUPDATES,
+    PATCH_PREVENTUPDATES_RBOOT,
+    PATCH_FOREIGNCARTS,
+    PATCH_TESTMENU,
+    PATCH_SECUREINFO,
+    PATCH_ERRDISPUNITINFO
+};
+
+typedef struct
+{
+    const u64 *titles;
+    u32 titleCount;
+    u32 gate;
+    const u8 *pattern;
+    u32 patternSize;
+    int offset;
+    const u8 *patch;
+    u32 patchSize;
+    u32 count;
+} PatchDescriptor;
+
+#define TITLES(a) a, sizeof(a) / sizeof(u64)
+#define BYTES(a)  a, sizeof(a)
+
+static const u64 homeMenuIds[] = {
+    0x0004003000008F02LL, // USA Menu
+    0x0004003000008202LL, // EUR Menu
+    0x0004003000009802LL, // JPN Menu
+    0x000400300000A102LL, // CHN Menu
+    0x000400300000A902LL, // KOR Menu
+    0x000400300000B102LL  // TWN Menu
+};
+static const u64 nimIds[] = { 0x0004013000002C02LL };
+static const u64 nsIds[] = { 0x0004013000008002LL };
+static const u64 cfgIds[] = { 0x0004013000001702LL };
+static const u64 roIds[] = { 0x0004013000003702LL };
+static const u64 errDispIds[] = { 0x0004003000008A02LL };
+
+static const u8 regionFreePattern[] = {
+    0x00, 0x00, 0x55, 0xE3, 0x01, 0x10, 0xA0
+};
+static const u8 regionFreePatch[] = {
+    0x01, 0x00, 0xA0, 0xE3, 0x1E, 0xFF, 0x2F, 0xE1
+};
+
+static const u8 blockAutoUpdatesPattern[] = {
+    0x25, 0x79, 0x0B, 0x99
+};
+static const u8 blockAutoUpdatesPatch[] = {
+    0xE3, 0xA0
+};
+
+static const u8 skipEshopUpdateCheckPattern[] = {
+    0x30, 0xB5, 0xF1, 0xB0
+};
+static const u8 skipEshopUpdateCheckPatch[] = {
+    0x00, 0x20, 0x08, 0x60, 0x70, 0x47
+};
+
+static const u8 stopCartUpdatesPattern[] = {
+    0x0C, 0x18, 0xE1, 0xD8
+};
+static const u8 stopCartUpdatesPatch[] = {
+    0x0B, 0x18, 0x21, 0xC8
+};
+
+//Thanks to Reisyukaku
+static const u8 forceHOMEMenuTIDPattern[] = {
+    /* ldr r0, =0x101 */
+    0xbc, 0x00, 0x9f, 0xe5,
+    /* bl getRegionSpecificAppID */
+    0x52, 0x45, 0x00, 0xeb
+};
+static const u8 forceHOMEMenuTIDPatch[] = {
+    /* mov r0, r9 (== 0x00008102) */
+    0x09, 0x10, 0xa0, 0xe1,
+    /* mov r1, r8 (== 0x00040030) */
+    0x08, 0x00, 0xa0, 0xe1
+};
+
+static const u8 secureinfoSigCheckPattern[] = {
+    0x06, 0x46, 0x10, 0x48
+};
+static const u8 secureinfoSigCheckPatch[] = {
+    0x00, 0x26
+};
+
+static const u8 sigCheckPattern[] = {
+    0x30, 0x40, 0x2D, 0xE9, 0x02
+};
+static const u8 sha256ChecksPattern1[] = {
+    0x30, 0x40, 0x2D, 0xE9, 0x24
+};
+static const u8 sha256ChecksPattern2[] = {
+    0xF8, 0x4F, 0x2D, 0xE9, 0x01
+};
+static const u8 stub[] = {
+    0x00, 0x00, 0xA0, 0xE3, 0x1E, 0xFF, 0x2F, 0xE1 // mov r0, #0; bx lr
+};
+
+static const u8 unitinfoCheckPattern1[] = {
+    0x14, 0x00, 0xD0, 0xE5, 0xDB
+};
+static const u8 unitinfoCheckPattern2[] = {
+    0x14, 0x00, 0xD0, 0xE5, 0x01
+};
+static const u8 unitinfoCheckPatch[] = {
+    0x00, 0x00, 0xA0, 0xE3
+};
+
+//Fixed patches, applied in order before the ones computed in patchCode
+static const PatchDescriptor patches[] = {
+    //Patch SMDH region checks
+    { TITLES(homeMenuIds), PATCH_REGIONFREE, BYTES(regionFreePattern), -16, BYTES(regionFreePatch), 1 },
+    //Block silent auto-updates
+    { TITLES(nimIds), PATCH_PREVENTUPDATES, BYTES(blockAutoUpdatesPattern), 0, BYTES(blockAutoUpdatesPatch), 1 },
+    //Skip update checks to access the EShop, only if the user booted with R
+    { TITLES(nimIds), PATCH_PREVENTUPDATES_RBOOT, BYTES(skipEshopUpdateCheckPattern), 0, BYTES(skipEshopUpdateCheckPatch), 1 },
+    //Disable updates from foreign carts (makes carts region-free)
+    { TITLES(nsIds), PATCH_FOREIGNCARTS, BYTES(stopCartUpdatesPattern), 0, BYTES(stopCartUpdatesPatch), 2 },
+    //Force TestMenu to load
+    { TITLES(nsIds), PATCH_TESTMENU, BYTES(forceHOMEMenuTIDPattern), 0, BYTES(forceHOMEMenuTIDPatch), 1 },
+    //Disable SecureInfo signature check
+    { TITLES(cfgIds), PATCH_SECUREINFO, BYTES(secureinfoSigCheckPattern), 0, BYTES(secureinfoSigCheckPatch), 1 },
+    //Disable CRR0 signature (RSA2048 with SHA256) check
+    { TITLES(roIds), PATCH_ALWAYS, BYTES(sigCheckPattern), 0, BYTES(stub), 1 },
+    //Disable CRO0/CRR0 SHA256 hash checks (section hashes, and hash table)
+    { TITLES(roIds), PATCH_ALWAYS, BYTES(sha256ChecksPattern1), 0, BYTES(stub), 1 },
+    { TITLES(roIds), PATCH_ALWAYS, BYTES(sha256ChecksPattern2), 0, BYTES(stub), 1 },
+    //Skip the UNITINFO checks in ErrDisp
+    { TITLES(errDispIds), PATCH_ERRDISPUNITINFO, BYTES(unitinfoCheckPattern1), 0, BYTES(unitinfoCheckPatch), 1 },
+    { TITLES(errDispIds), PATCH_ERRDISPUNITINFO, BYTES(unitinfoCheckPattern2), 0, BYTES(unitinfoCheckPatch), 3 }
+};
+
+#define PATCH_COUNT (sizeof(patches) / sizeof(PatchDescriptor))
+
+static bool patchGateOpen(u32 gate)
+{
+    switch(gate)
+    {
+        case PATCH_ALWAYS: return true;
+        case PATCH_REGIONFREE: return CONFIG(REGIONFREE);
+        case PATCH_PREVENTUPDATES: return CONFIG(PREVENTUPDATES);
+        case PATCH_PREVENTUPDATES_RBOOT: return CONFIG(PREVENTUPDATES) && (BOOTCFG_NAND != 0) != (BOOTCFG_FIRM != 0);
+        case PATCH_FOREIGNCARTS: return CONFIG(REGIONFREE) || CONFIG(PREVENTUPDATES);
+        case PATCH_TESTMENU: return CONFIG(TESTMENU);
+        case PATCH_SECUREINFO: return CONFIG(SECUREINFO);
+        case PATCH_ERRDISPUNITINFO: return MULTICONFIG(DEVOPTIONS) == 1;
+        default: return false;
+    }
+}
 
-    switch(progId)
+static void applyPatchTable(u64 progId, u8 *code, u32 size)
+{
+    //The loader stays resident, so every skip table is only built the first time its patch is used
+    static u8 tables[PATCH_COUNT][256];
+    static bool tableBuilt[PATCH_COUNT];
+
+    for(u32 i = 0; i < PATCH_COUNT; i++)
     {
-        case 0x0004003000008F02LL: // USA Menu
-        case 0x0004003000008202LL: // EUR Menu
-        case 0x0004003000009802LL: // JPN Menu
-        case 0x000400300000A102LL: // CHN Menu
-        case 0x000400300000A902LL: // KOR Menu
-        case 0x000400300000B102LL: // TWN Menu
+        const PatchDescriptor *patch = &patches[i];
+        bool match = false;
+
+        for(u32 j = 0; j < patch->titleCount && !match; j++)
+            match = patch->titles[j] == progId;
+
+        if(!match || !patchGateOpen(patch->gate)) continue;
+
+        if(!tableBuilt[i])
         {
-            static const u8 regionFreePattern[] = {
-                0x00, 0x00, 0x55, 0xE3, 0x01, 0x10, 0xA0
-            };
-            static const u8 regionFreePatch[] = {
-                0x01, 0x00, 0xA0, 0xE3, 0x1E, 0xFF, 0x2F, 0xE1
-            };
+            memsearchTable(tables[i], patch->pattern, patch->patternSize);
+            tableBuilt[i] = true;
+        }
 
-            //Patch SMDH region checks
-			if(CONFIG(REGIONFREE))
-				patchMemory(code, size, 
-					regionFreePattern, 
-					sizeof(regionFreePattern), -16, 
-					regionFreePatch, 
-					sizeof(regionFreePatch), 1
-				);
+        patchMemoryWithTable(code, size, patch->pattern, patch->patternSize, patch->offset, patch->patch, patch->patchSize, patch->count, tables[i]);
+    }
+}
 
-            break;
+static void loadTitlePatches(u64 progId, u8 *code, u32 size)
+{
+    /* Here we look for "/puma/patches/[u64 titleID in hex, uppercase].bin"
+       If it exists it should be a list of records: u8 pattern size (1-255), u8 patch size,
+       s16 offset, u16 count (little endian), then the pattern and the patch */
+
+    char path[] = "/puma/patches/0000000000000000.bin";
+    progIdToStr(path + 29, progId);
+
+    //Kept out of the 4KB stack
+    static u8 buf[0x1000];
+    u64 fileSize;
+
+    if(R_FAILED(fileRead(path, buf, sizeof(buf), &fileSize))) return;
+
+    for(u32 pos = 0; pos + 6 <= fileSize;)
+    {
+        u32 patternSize = buf[pos],
+            patchSize = buf[pos + 1],
+            count = buf[pos + 4] | (buf[pos + 5] << 8);
+        int offset = (s16)(buf[pos + 2] | (buf[pos + 3] << 8));
+
+        pos += 6;
+        if(patternSize == 0 || pos + patternSize + patchSize > fileSize) break;
+
+        patchMemory(code, size, buf + pos, patternSize, offset, buf + pos + patternSize, patchSize, count);
+        pos += patternSize + patchSize;
+    }
+}
+
+static bool lookUpCodeCacheConfig(u64 progId, u32 *patchesConfig)
+{
+    *patchesConfig = 0;
+
+    if(CONFIG(USELANGEMUANDCODE))
+    {
+        //An external .code section or patch list makes the title uncacheable
+        char codePath[] = "/puma/code_sections/0000000000000000.bin",
+             patchesPath[] = "/puma/patches/0000000000000000.bin";
+        progIdToStr(codePath + 35, progId);
+        progIdToStr(patchesPath + 29, progId);
+
+        IFile file;
+
+        if(R_SUCCEEDED(fileOpen(&file, ARCHIVE_SDMC, codePath, FS_OPEN_READ)) ||
+           R_SUCCEEDED(fileOpen(&file, ARCHIVE_SDMC, patchesPath, FS_OPEN_READ)))
+        {
+            IFile_Close(&file);
+            return false;
         }
 
-        case 0x0004013000002C02LL: // NIM
+        u8 regionId = 0xFF,
+           languageId = 0xFF;
+        loadTitleLocaleConfig(progId, &regionId, &languageId);
+
+        *patchesConfig = 1 | (regionId << 8) | (languageId << 16);
+    }
+
+    return true;
+}
+
+bool getCodeCacheConfig(u64 progId, u32 *cfwCommit, u32 *patchesConfig)
+{
+    //The SD files are only looked at on the first launch of a title in this session
+    static struct
+    {
+        u64 progId;
+        u32 patchesConfig;
+        bool usable;
+    } configs[16];
+    static u32 configCount = 0,
+               nextConfig = 0;
+
+    loadCFWInfo();
+
+    //Only applications are cached, the patches to system titles also depend on other files and on the NAND
+    if((u32)((progId & 0xFFFFFFF000000000LL) >> 0x24) != 0x0004000) return false;
+
+    *cfwCommit = info.commitHash;
+
+    for(u32 i = 0; i < configCount; i++)
+        if(configs[i].progId == progId)
         {
-            static const u8 blockAutoUpdatesPattern[] = {
-                0x25, 0x79, 0x0B, 0x99
-            };
-            static const u8 blockAutoUpdatesPatch[] = {
-                0xE3, 0xA0
-            };
+            *patchesConfig = configs[i].patchesConfig;
+            return configs[i].usable;
+        }
 
-            //Block silent auto-updates
-			if(CONFIG(PREVENTUPDATES))
-				patchMemory(code, size, 
-					blockAutoUpdatesPattern, 
-					sizeof(blockAutoUpdatesPattern), 0, 
-					blockAutoUpdatesPatch, 
-					sizeof(blockAutoUpdatesPatch), 1
-				);
+    bool usable = lookUpCodeCacheConfig(progId, patchesConfig);
 
-            //Apply only if the user booted with R
-            if((BOOTCFG_NAND != 0) != (BOOTCFG_FIRM != 0))
-            {
-                static const u8 skipEshopUpdateCheckPattern[] = {
-                    0x30, 0xB5, 0xF1, 0xB0
-                };
-                static const u8 skipEshopUpdateCheckPatch[] = {
-                    0x00, 0x20, 0x08, 0x60, 0x70, 0x47
-                };
+    //Replace the oldest entry once the table is full
+    configs[nextConfig].progId = progId;
+    configs[nextConfig].patchesConfig = *patchesConfig;
+    configs[nextConfig].usable = usable;
+    nextConfig = (nextConfig + 1) % (sizeof(configs) / sizeof(configs[0]));
+    if(configCount < sizeof(configs) / sizeof(configs[0])) configCount++;
 
-                //Skip update checks to access the EShop
-				if(CONFIG(PREVENTUPDATES))
-					patchMemory(code, size, 
-						skipEshopUpdateCheckPattern, 
-						sizeof(skipEshopUpdateCheckPattern), 0, 
-						skipEshopUpdateCheckPatch, 
-						sizeof(skipEshopUpdateCheckPatch), 1
-					);
-            }
-			
-			
+    return usable;
+}
+
+void patchCode(u64 progId, u8 *code, u32 size)
+{
+    loadCFWInfo();
+
+    applyPatchTable(progId, code, size);
+
+    switch(progId)
+    {
+        case 0x0004013000002C02LL: // NIM
+        {
 			//eShop country forcer, by Yifan Lu
 			static const char eshopCountryPattern[] = {
 			  0x01, 0x20, 0x01, 0x90,
@@ -508,42 +720,6 @@ void patchCode(u64 progId, u8 *code, u32 size)
 
         case 0x0004013000008002LL: // NS
         {
-            static const u8 stopCartUpdatesPattern[] = {
-                0x0C, 0x18, 0xE1, 0xD8
-            };
-            static const u8 stopCartUpdatesPatch[] = {
-                0x0B, 0x18, 0x21, 0xC8
-            };
-
-            //Disable updates from foreign carts (makes carts region-free)
-			if( CONFIG(REGIONFREE) || CONFIG(PREVENTUPDATES) )
-				patchMemory(code, size, 
-					stopCartUpdatesPattern, 
-					sizeof(stopCartUpdatesPattern), 0, 
-					stopCartUpdatesPatch,
-					sizeof(stopCartUpdatesPatch), 2
-				);
-				
-			//Force TestMenu to load (thanks to Reisyukaku)	
-				static const u8 forceHOMEMenuTIDPattern[] = {
-					/* ldr r0, =0x101 */
-					0xbc, 0x00, 0x9f, 0xe5,
-					/* bl getRegionSpecificAppID */
-					0x52, 0x45, 0x00, 0xeb
-				};
-				static const u8 forceHOMEMenuTIDPatch[] = {
-					/* mov r0, r9 (== 0x00008102) */
-					0x09, 0x10, 0xa0, 0xe1,
-					/* mov r1, r8 (== 0x00040030) */
-					0x08, 0x00, 0xa0, 0xe1
-				};
-				if(CONFIG(TESTMENU))
-					patchMemory(code, size,
-						forceHOMEMenuTIDPattern, sizeof(forceHOMEMenuTIDPattern), 0,
-						forceHOMEMenuTIDPatch, sizeof(forceHOMEMenuTIDPatch), 1
-					);	
-
-
             u32 cpuSetting = MULTICONFIG(NEWCPU);
 
             if(cpuSetting != 0)
@@ -567,22 +743,6 @@ void patchCode(u64 progId, u8 *code, u32 size)
 
         case 0x0004013000001702LL: // CFG
         {
-            static const u8 secureinfoSigCheckPattern[] = {
-                0x06, 0x46, 0x10, 0x48
-            };
-            static const u8 secureinfoSigCheckPatch[] = {
-                0x00, 0x26
-            };
-
-            //Disable SecureInfo signature check
-			if(CONFIG(SECUREINFO))
-				patchMemory(code, size, 
-					secureinfoSigCheckPattern, 
-					sizeof(secureinfoSigCheckPattern), 0, 
-					secureinfoSigCheckPatch, 
-					sizeof(secureinfoSigCheckPatch), 1
-				);
-
             if(secureInfoExists())
             {
                 static const u16 secureinfoFilenamePattern[] = u"SecureInfo_";
@@ -602,82 +762,6 @@ void patchCode(u64 progId, u8 *code, u32 size)
             break;
         }
         
-        case 0x0004013000003702LL: // RO
-        {
-            static const u8 sigCheckPattern[] = {
-                0x30, 0x40, 0x2D, 0xE9, 0x02
-            };
-            static const u8 sha256ChecksPattern1[] = {
-                0x30, 0x40, 0x2D, 0xE9, 0x24
-            };
-            static const u8 sha256ChecksPattern2[] = {
-                0xF8, 0x4F, 0x2D, 0xE9, 0x01
-            };
-            
-            static const u8 stub[] = {
-                0x00, 0x00, 0xA0, 0xE3, 0x1E, 0xFF, 0x2F, 0xE1 // mov r0, #0; bx lr
-            };
-            
-            //Disable CRR0 signature (RSA2048 with SHA256) check
-            patchMemory(code, size, 
-                sigCheckPattern, 
-                sizeof(sigCheckPattern), 0, 
-                stub,
-                sizeof(stub), 1
-            );
-            
-            //Disable CRO0/CRR0 SHA256 hash checks (section hashes, and hash table)
-            patchMemory(code, size, 
-                sha256ChecksPattern1, 
-                sizeof(sha256ChecksPattern1), 0, 
-                stub,
-                sizeof(stub), 1
-            );
-            
-            patchMemory(code, size, 
-                sha256ChecksPattern2, 
-                sizeof(sha256ChecksPattern2), 0, 
-                stub,
-                sizeof(stub), 1
-            );
-            
-            break;
-        }
-
-        case 0x0004003000008A02LL: // ErrDisp
-        {
-            if(MULTICONFIG(DEVOPTIONS) == 1)
-            {
-                static const u8 unitinfoCheckPattern1[] = { 
-                    0x14, 0x00, 0xD0, 0xE5, 0xDB
-                };
-
-                static const u8 unitinfoCheckPattern2[] = {
-                    0x14, 0x00, 0xD0, 0xE5, 0x01
-                } ;
-
-                static const u8 unitinfoCheckPatch[] = {
-                    0x00, 0x00, 0xA0, 0xE3
-                } ;
-
-                patchMemory(code, size, 
-                    unitinfoCheckPattern1, 
-                    sizeof(unitinfoCheckPattern1), 0, 
-                    unitinfoCheckPatch, 
-                    sizeof(unitinfoCheckPatch), 1
-                );
-
-                patchMemory(code, size, 
-                    unitinfoCheckPattern2, 
-                    sizeof(unitinfoCheckPattern2), 0,
-                    unitinfoCheckPatch, 
-                    sizeof(unitinfoCheckPatch), 3
-                );
-            }
-
-            break;
-        }
-
         default:
             if(CONFIG(USELANGEMUANDCODE))
             {
@@ -707,4 +791,7 @@ void patchCode(u64 progId, u8 *code, u32 size)
 
         break;
     }
+
+    //Patch lists from SD, applied last so that they can rely on the patches above
+    if(CONFIG(USELANGEMUANDCODE)) loadTitlePatches(progId, code, size);
 }
\ No newline at end of file
@@ -37,4 +37,5 @@ enum singleOptions
 	SECUREINFO,
 	TESTMENU
 };
+bool getCodeCacheConfig(u64 progId, u32 *cfwCommit, u32 *patchesConfig);
 void patchCode(u64 progId, u8 *code, u32 size);
\ No newline at end of file
@@ -0,0 +1,59 @@
+#include <3ds/types.h>
+#include "sessions.h"
+
+void sessions_init(session_list_t *list, int max)
+{
+  list->count = SESSION_FIRST;
+  list->max = max < MAX_SESSIONS ? max : MAX_SESSIONS;
+}
+
+// returns 0 when all the sessions are taken, the caller closes the new one then
+int sessions_add(session_list_t *list, Handle session)
+{
+  if (list->count >= SESSION_FIRST+list->max)
+  {
+    return 0;
+  }
+  list->handles[list->count++] = session;
+  return 1;
+}
+
+int sessions_find(const session_list_t *list, Handle session)
+{
+  int i;
+
+  for (i = SESSION_FIRST; i < list->count; i++)
+  {
+    if (list->handles[i] == session)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// moves the session just served behind the others, so that a busy session can't starve them
+void sessions_served(session_list_t *list, int index)
+{
+  Handle session;
+  int i;
+
+  session = list->handles[index];
+  for (i = index; i < list->count-1; i++)
+  {
+    list->handles[i] = list->handles[i+1];
+  }
+  list->handles[list->count-1] = session;
+}
+
+// keeps the order of the others, moving the last session into the hole would let it skip the queue
+void sessions_remove(session_list_t *list, int index)
+{
+  int i;
+
+  for (i = index; i < list->count-1; i++)
+  {
+    list->handles[i] = list->handles[i+1];
+  }
+  list->count--;
+}
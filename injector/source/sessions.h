@@ -0,0 +1,24 @@
+#pragma once
+
+#include <3ds/types.h>
+
+#define MAX_SESSIONS 4
+
+// handles the service loop waits on: the srv notification, the service port, then the client sessions
+#define SESSION_NOTIFICATION 0
+#define SESSION_PORT         1
+#define SESSION_FIRST        2
+
+// svcReplyAndReceive returns the lowest signaled index, so the sessions are kept in the order they are to be served in
+typedef struct
+{
+  Handle handles[SESSION_FIRST+MAX_SESSIONS];
+  int count;  // handles in use, the first SESSION_FIRST included
+  int max;    // client sessions accepted at most
+} session_list_t;
+
+void sessions_init(session_list_t *list, int max);
+int sessions_add(session_list_t *list, Handle session);
+int sessions_find(const session_list_t *list, Handle session);
+void sessions_served(session_list_t *list, int index);
+void sessions_remove(session_list_t *list, int index);
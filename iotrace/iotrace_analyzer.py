@@ -0,0 +1,171 @@
+#!/usr/bin/env python
+# Requires Python >= 3.3 or >= 2.7
+
+#   This file is part of Luma3DS
+#   Copyright (C) 2016 Aurora Wright, TuxSH
+#
+#   This program is free software: you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation, either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+#   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+#   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+#   Notices displayed by works containing it.
+
+__license__   = "GPLv3"
+__version__   = "v1.0"
+
+"""
+Reports on the SD/NAND requests recorded by an iotrace payload (/puma/iotrace.bin):
+request size histograms, seek patterns and sectors read more than once; the reads
+can also be replayed against disk images
+"""
+
+import argparse
+import os
+import time
+from collections import Counter
+from struct import unpack_from
+
+TICKS_PER_SEC = 67027964
+SECTOR_SIZE = 0x200
+driveNames = ("SD", "CTRNAND")
+
+def parseTrace(filename):
+    '''
+    @brief Reads a trace file.
+    @return (total number of requests made, list of (drive, isWrite, sector, count, ticks, result)) with the oldest request first
+    '''
+    with open(filename, "rb") as f: data = f.read()
+
+    if len(data) < 16: raise SystemExit("Invalid file format")
+    magic, version, entrySize, totalEntries, entryCount = unpack_from("<I2H2I", data)
+    if magic != 0x52544F49: raise SystemExit("Invalid file format")
+    if version != 1 or entrySize < 16: raise SystemExit("Incompatible format version")
+    if 16 + entryCount * entrySize > len(data): raise SystemExit("Truncated trace")
+
+    entries = []
+    for i in range(entryCount):
+        sector, count, ticks, drive, isWrite, result = unpack_from("<3I2BH", data, 16 + i * entrySize)
+        entries.append((drive, isWrite != 0, sector, count, ticks, result))
+
+    return totalEntries, entries
+
+def log2Bucket(n):
+    '''
+    @brief Power of two range n falls in, as a string ("1", "2-3", "4-7"...).
+    '''
+    if n <= 1: return str(n)
+    low = 1 << (n.bit_length() - 1)
+    return "{0}-{1}".format(low, 2 * low - 1)
+
+def printHistogram(title, counter):
+    print(title)
+    for key in sorted(counter, key=lambda k: (len(k), k)): print("{0:>17}: {1}".format(key, counter[key]))
+    print("")
+
+def replay(entries, images):
+    '''
+    @brief Reads what each traced read request read from the corresponding disk image and times it.
+    '''
+    files = {}
+    try:
+        for drive, filename in images.items(): files[drive] = open(filename, "rb")
+
+        for drive in sorted(files):
+            f, sectors, requests, outOfRange = files[drive], 0, 0, 0
+            imageSectors = os.fstat(f.fileno()).st_size // SECTOR_SIZE
+            consoleTicks = 0
+
+            start = time.time()
+            for entryDrive, isWrite, sector, count, ticks, _ in entries:
+                if entryDrive != drive or isWrite: continue
+                if sector + count > imageSectors:
+                    outOfRange += 1
+                    continue
+                f.seek(sector * SECTOR_SIZE)
+                f.read(count * SECTOR_SIZE)
+                requests += 1
+                sectors += count
+                consoleTicks += ticks
+            elapsed = time.time() - start
+
+            print("Replay on {0}: {1} reads ({2} KB) in {3:.3f} ms, {4:.3f} ms on the console, {5} out of the image".format(
+                  driveNames[drive], requests, sectors * SECTOR_SIZE // 1024, elapsed * 1000,
+                  consoleTicks * 1000.0 / TICKS_PER_SEC, outOfRange))
+    finally:
+        for f in files.values(): f.close()
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Analyze Puma33DS I/O traces")
+    parser.add_argument("trace", help="trace file (iotrace.bin)")
+    parser.add_argument("-i", "--image", action="append", default=[], metavar="DRIVE=FILE",
+                        help="replay the reads of DRIVE ('sd', or 'ctrnand' for a decrypted image of the CTRNAND FAT partition) on an image")
+    parser.add_argument("-n", "--top", type=int, default=10, help="number of most re-read ranges to show")
+    args = parser.parse_args()
+
+    totalEntries, entries = parseTrace(args.trace)
+    print("{0} requests traced{1}\n".format(len(entries),
+          "" if totalEntries == len(entries) else " (the first {0} were overwritten)".format(totalEntries - len(entries))))
+
+    for drive in range(len(driveNames)):
+        driveEntries = [e for e in entries if e[0] == drive]
+        if not driveEntries: continue
+
+        reads = [e for e in driveEntries if not e[1]]
+        writes = [e for e in driveEntries if e[1]]
+        ticks = sum(e[4] for e in driveEntries)
+        sectors = sum(e[3] for e in driveEntries)
+
+        print("== {0} ==".format(driveNames[drive]))
+        print("{0} reads, {1} writes, {2} KB in {3:.3f} ms ({4:.2f} MB/s), {5} failed\n".format(
+              len(reads), len(writes), sectors * SECTOR_SIZE // 1024, ticks * 1000.0 / TICKS_PER_SEC,
+              sectors * SECTOR_SIZE / (ticks / float(TICKS_PER_SEC)) / (1 << 20) if ticks else 0,
+              sum(1 for e in driveEntries if e[5] != 0)))
+
+        printHistogram("Request sizes (sectors):", Counter(log2Bucket(e[3]) for e in driveEntries))
+
+        #Where each request starts relative to where the previous one on the same drive ended
+        seeks, previousEnd = Counter(), None
+        for _, _, sector, count, _, _ in driveEntries:
+            if previousEnd is None: pass
+            elif sector == previousEnd: seeks["sequential"] += 1
+            elif sector > previousEnd: seeks["+" + log2Bucket(sector - previousEnd)] += 1
+            else: seeks["-" + log2Bucket(previousEnd - sector)] += 1
+            previousEnd = sector + count
+        printHistogram("Seeks (sectors):", seeks)
+
+        #Sectors read again while nothing was written to them in between
+        readSectors, reReads, wasted = set(), Counter(), 0
+        for _, isWrite, sector, count, _, _ in driveEntries:
+            sectorRange = range(sector, sector + count)
+            if isWrite:
+                readSectors.difference_update(sectorRange)
+                continue
+            again = sum(1 for s in sectorRange if s in readSectors)
+            if again:
+                wasted += again
+                reReads[(sector, count)] += 1
+            readSectors.update(sectorRange)
+
+        print("Sectors read more than once: {0} ({1} KB)".format(wasted, wasted * SECTOR_SIZE // 1024))
+        for (sector, count), times in reReads.most_common(args.top):
+            print("{0:>17}: {1} sector(s) at 0x{2:x}".format("{0} time(s)".format(times), count, sector))
+        print("")
+
+    images = {}
+    for spec in args.image:
+        drive, _, filename = spec.partition("=")
+        if drive.upper() not in driveNames: raise SystemExit("Unknown drive: " + drive)
+        images[driveNames.index(drive.upper())] = filename
+
+    if images: replay(entries, images)
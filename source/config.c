@@ -71,7 +71,7 @@ void configMenu(bool oldPinStatus, u32 oldPinMode)
                                         "Splash: Off( ) Before( ) After( ) payloads",
                                         "PIN lock: Off( ) 4( ) 6( ) 8( ) digits",
                                         "New 3DS CPU: Off( ) Clock( ) L2( ) Clock+L2( )",
-                                        "Dev. features: Off( ) ErrDisp( ) UNITINFO( )"
+                                        "Dev.: Off( ) ErrDisp( ) UNITINFO( ) Headless( )"
                                       };
 
     const char *singleOptionsText[] = { "( ) Autoboot SysNAND",
@@ -123,7 +123,10 @@ void configMenu(bool oldPinStatus, u32 oldPinMode)
                                           "\t* 'UNITINFO' makes the console be always\n"
                                           "detected as a development unit (which\n"
                                           "breaks online features and Amiibos\n"
-                                          "but enhances some dev apps).",
+                                          "but enhances some dev apps).\n"
+                                          "\t* 'Headless' saves exception dumps\n"
+                                          "without displaying them and keeps\n"
+                                          "booting (for unattended consoles).",
 
                                           "If enabled SysNAND will be launched on\n"
                                           "boot. Otherwise, an EmuNAND will.\n"
@@ -221,7 +224,7 @@ void configMenu(bool oldPinStatus, u32 oldPinMode)
         { .posXs = {12, 22, 31, 0}  },
         { .posXs = {14, 19, 24, 29} },
         { .posXs = {17, 26, 32, 44} },
-        { .posXs = {19, 30, 42, 0}  }
+        { .posXs = {10, 21, 33, 45} }
     };
 
     //Calculate the amount of the various kinds of options and pre-select the first single one
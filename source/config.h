@@ -80,7 +80,6 @@ typedef enum ConfigurationStatus
 } ConfigurationStatus;
 
 extern CfgData configData;
-extern bool isN3DS;
 
 bool readConfig(void);
 void writeConfig(ConfigurationStatus needConfig, u32 configTemp);
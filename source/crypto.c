@@ -29,6 +29,9 @@
 #include "crypto.h"
 #include "memory.h"
 #include "fatfs/sdmmc/sdmmc.h"
+#ifdef CRYPTO_SOFTWARE
+#include "softcrypto.h"
+#endif
 
 /****************************************************************
 *                  Crypto libs
@@ -36,7 +39,19 @@
 
 /* original version by megazig */
 
-#ifndef __thumb__
+#if defined(CRYPTO_SOFTWARE)
+#define BSWAP32(x) {x = __builtin_bswap32(x);}
+
+#define ADD_u128_u32(u128_0, u128_1, u128_2, u128_3, u32_0) {\
+    u64 sum = (u64)u128_0 + (u32_0);\
+    u128_0 = (u32)sum;\
+    sum = (u64)u128_1 + (sum >> 32);\
+    u128_1 = (u32)sum;\
+    sum = (u64)u128_2 + (sum >> 32);\
+    u128_2 = (u32)sum;\
+    u128_3 += (u32)(sum >> 32);\
+}
+#elif !defined(__thumb__)
 #define BSWAP32(x) {\
     __asm__\
     (\
@@ -80,11 +95,56 @@ __asm__\
 }
 #endif /*__thumb__*/
 
+static void aes_advctr(void *ctr, u32 val, u32 mode)
+{
+    u32 *ctr32 = (u32 *)ctr;
+
+    int i;
+    if(mode & AES_INPUT_BE)
+    {
+        for(i = 0; i < 4; ++i) // Endian swap
+            BSWAP32(ctr32[i]);
+    }
+
+    if(mode & AES_INPUT_NORMAL)
+    {
+        ADD_u128_u32(ctr32[3], ctr32[2], ctr32[1], ctr32[0], val);
+    }
+    else
+    {
+        ADD_u128_u32(ctr32[0], ctr32[1], ctr32[2], ctr32[3], val);
+    }
+
+    if(mode & AES_INPUT_BE)
+    {
+        for(i = 0; i < 4; ++i) // Endian swap
+            BSWAP32(ctr32[i]);
+    }
+}
+
+//Host builds get aes_setkey, aes_use_keyslot, aes and the SHA functions from softcrypto.c
+#ifndef CRYPTO_SOFTWARE
+// Last input mode and keyslot programmed in the engine, to skip redundant register writes
+static u32 aesInputMode = 0xFFFFFFFF;
+static u8 aesSelectedKeyslot = 0xFF;
+
+static void aes_set_input_mode(u32 mode)
+{
+    if(mode == aesInputMode) return;
+
+    *REG_AESCNT = (*REG_AESCNT & ~(AES_CNT_INPUT_ENDIAN | AES_CNT_INPUT_ORDER)) | mode;
+    aesInputMode = mode;
+}
+
 static void aes_setkey(u8 keyslot, const void *key, u32 keyType, u32 mode)
 {
     if(keyslot <= 0x03) return; // Ignore TWL keys for now
     u32 *key32 = (u32 *)key;
-    *REG_AESCNT = (*REG_AESCNT & ~(AES_CNT_INPUT_ENDIAN | AES_CNT_INPUT_ORDER)) | mode;
+    aes_set_input_mode(mode);
+
+    // The new key only gets used once the keyslot is selected again
+    if(keyslot == aesSelectedKeyslot) aesSelectedKeyslot = 0xFF;
+
     *REG_AESKEYCNT = (*REG_AESKEYCNT >> 6 << 6) | keyslot | AES_KEYCNT_WRITE;
 
     REG_AESKEYFIFO[keyType] = key32[0];
@@ -95,17 +155,18 @@ static void aes_setkey(u8 keyslot, const void *key, u32 keyType, u32 mode)
 
 static void aes_use_keyslot(u8 keyslot)
 {
-    if(keyslot > 0x3F)
+    if(keyslot > 0x3F || keyslot == aesSelectedKeyslot)
         return;
 
     *REG_AESKEYSEL = keyslot;
     *REG_AESCNT = *REG_AESCNT | 0x04000000; /* mystery bit */
+    aesSelectedKeyslot = keyslot;
 }
 
 static void aes_setiv(const void *iv, u32 mode)
 {
     const u32 *iv32 = (const u32 *)iv;
-    *REG_AESCNT = (*REG_AESCNT & ~(AES_CNT_INPUT_ENDIAN | AES_CNT_INPUT_ORDER)) | mode;
+    aes_set_input_mode(mode);
 
     // Word order for IV can't be changed in REG_AESCNT and always default to reversed
     if(mode & AES_INPUT_NORMAL)
@@ -124,33 +185,6 @@ static void aes_setiv(const void *iv, u32 mode)
     }
 }
 
-static void aes_advctr(void *ctr, u32 val, u32 mode)
-{
-    u32 *ctr32 = (u32 *)ctr;
-
-    int i;
-    if(mode & AES_INPUT_BE)
-    {
-        for(i = 0; i < 4; ++i) // Endian swap
-            BSWAP32(ctr32[i]);
-    }
-
-    if(mode & AES_INPUT_NORMAL)
-    {
-        ADD_u128_u32(ctr32[3], ctr32[2], ctr32[1], ctr32[0], val);
-    }
-    else
-    {
-        ADD_u128_u32(ctr32[0], ctr32[1], ctr32[2], ctr32[3], val);
-    }
-
-    if(mode & AES_INPUT_BE)
-    {
-        for(i = 0; i < 4; ++i) // Endian swap
-            BSWAP32(ctr32[i]);
-    }
-}
-
 static void aes_change_ctrmode(void *ctr, u32 fromMode, u32 toMode)
 {
     u32 *ctr32 = (u32 *)ctr;
@@ -212,6 +246,7 @@ static void aes(void *dst, const void *src, u32 blockCount, void *iv, u32 mode,
                     AES_CNT_INPUT_ORDER | AES_CNT_OUTPUT_ORDER |
                     AES_CNT_INPUT_ENDIAN | AES_CNT_OUTPUT_ENDIAN |
                     AES_CNT_FLUSH_READ | AES_CNT_FLUSH_WRITE;
+    aesInputMode = AES_INPUT_BE | AES_INPUT_NORMAL;
 
     u32 blocks;
     while(blockCount != 0)
@@ -254,29 +289,72 @@ static void sha_wait_idle()
     while(*REG_SHA_CNT & 1);
 }
 
-static void sha(void *res, const void *src, u32 size, u32 mode)
+//The engine keeps the running hash, only the bytes of an incomplete block are buffered here
+static u8 __attribute__((aligned(4))) shaBuffer[0x40];
+static u32 shaBufferSize,
+           shaMode;
+
+static void sha_feed_block(const u32 *src32)
+{
+    sha_wait_idle();
+    for(int i = 0; i < 4; ++i)
+    {
+        *REG_SHA_INFIFO = *src32++;
+        *REG_SHA_INFIFO = *src32++;
+        *REG_SHA_INFIFO = *src32++;
+        *REG_SHA_INFIFO = *src32++;
+    }
+}
+
+void sha_init(u32 mode)
 {
     sha_wait_idle();
     *REG_SHA_CNT = mode | SHA_CNT_OUTPUT_ENDIAN | SHA_NORMAL_ROUND;
 
-    const u32 *src32 = (const u32 *)src;
-    int i;
-    while(size >= 0x40)
+    shaMode = mode;
+    shaBufferSize = 0;
+}
+
+void sha_update(const void *src, u32 size)
+{
+    const u8 *src8 = (const u8 *)src;
+
+    if(shaBufferSize != 0)
     {
-        sha_wait_idle();
-        for(i = 0; i < 4; ++i)
+        u32 fill = sizeof(shaBuffer) - shaBufferSize;
+        if(fill > size) fill = size;
+
+        memcpy(shaBuffer + shaBufferSize, src8, fill);
+        shaBufferSize += fill;
+        src8 += fill;
+        size -= fill;
+
+        if(shaBufferSize < sizeof(shaBuffer)) return;
+
+        sha_feed_block((const u32 *)shaBuffer);
+        shaBufferSize = 0;
+    }
+
+    //The FIFO only takes words, unaligned data goes through the buffer
+    bool aligned = ((u32)src8 & 3) == 0;
+    for(; size >= sizeof(shaBuffer); size -= sizeof(shaBuffer), src8 += sizeof(shaBuffer))
+    {
+        if(aligned) sha_feed_block((const u32 *)src8);
+        else
         {
-            *REG_SHA_INFIFO = *src32++;
-            *REG_SHA_INFIFO = *src32++;
-            *REG_SHA_INFIFO = *src32++;
-            *REG_SHA_INFIFO = *src32++;
+            memcpy(shaBuffer, src8, sizeof(shaBuffer));
+            sha_feed_block((const u32 *)shaBuffer);
         }
-
-        size -= 0x40;
     }
 
+    memcpy(shaBuffer, src8, size);
+    shaBufferSize = size;
+}
+
+void sha_final(void *res)
+{
     sha_wait_idle();
-    memcpy((void *)REG_SHA_INFIFO, src32, size);
+    memcpy((void *)REG_SHA_INFIFO, shaBuffer, shaBufferSize);
 
     *REG_SHA_CNT = (*REG_SHA_CNT & ~SHA_NORMAL_ROUND) | SHA_FINAL_ROUND;
 
@@ -284,21 +362,31 @@ static void sha(void *res, const void *src, u32 size, u32 mode)
     sha_wait_idle();
 
     u32 hashSize = SHA_256_HASH_SIZE;
-    if(mode == SHA_224_MODE)
+    if(shaMode == SHA_224_MODE)
         hashSize = SHA_224_HASH_SIZE;
-    else if(mode == SHA_1_MODE)
+    else if(shaMode == SHA_1_MODE)
         hashSize = SHA_1_HASH_SIZE;
 
     memcpy(res, (void *)REG_SHA_HASH, hashSize);
 }
 
+static void sha(void *res, const void *src, u32 size, u32 mode)
+{
+    sha_init(mode);
+    sha_update(src, size);
+    sha_final(res);
+}
+#endif
+
 /*****************************************************************/
 
 static u8 __attribute__((aligned(4))) nandCtr[AES_BLOCK_SIZE];
 static u8 nandSlot;
 static u32 fatStart;
+#ifndef CRYPTO_SOFTWARE
 static u8 __attribute__((aligned(4))) shaHashBackup[SHA_256_HASH_SIZE];
 static bool didShaHashBackup = false;
+#endif
 
 void ctrNandInit(void)
 {
@@ -309,6 +397,7 @@ void ctrNandInit(void)
     sha(shaSum, cid, sizeof(cid), SHA_256_MODE);
     memcpy(nandCtr, shaSum, sizeof(nandCtr));
 
+#ifndef BUILD_O3DS
     if(isN3DS)
     {
         u8 __attribute__((aligned(4))) keyY0x5[AES_BLOCK_SIZE] = {0x4D, 0x80, 0x4F, 0x4E, 0x99, 0x90, 0x19, 0x46, 0x13, 0xA2, 0x04, 0xAC, 0x58, 0x44, 0x60, 0xBE};
@@ -318,35 +407,64 @@ void ctrNandInit(void)
         fatStart = 0x5CAD7;
     }
     else
+#endif
     {
         nandSlot = 0x04;
         fatStart = 0x5CAE5;
     }
 }
 
-u32 ctrNandRead(u32 sector, u32 sectorCount, u8 *outbuf)
+static u32 ctrNandReadSectors(u32 sector, u32 sectorCount, u8 *outbuf)
 {
     u8 __attribute__((aligned(4))) tmpCtr[sizeof(nandCtr)];
     memcpy(tmpCtr, nandCtr, sizeof(nandCtr));
     aes_advctr(tmpCtr, ((sector + fatStart) * 0x200) / AES_BLOCK_SIZE, AES_INPUT_BE | AES_INPUT_NORMAL);
 
     //Read
-    u32 result;
     if(firmSource == FIRMWARE_SYSNAND)
-        result = sdmmc_nand_readsectors(sector + fatStart, sectorCount, outbuf);
+        sdmmc_nand_readsectors_submit(sector + fatStart, sectorCount, outbuf);
     else
     {
         sector += emuOffset;
-        result = sdmmc_sdcard_readsectors(sector + fatStart, sectorCount, outbuf);
+        sdmmc_sdcard_readsectors_submit(sector + fatStart, sectorCount, outbuf);
     }
 
-    //Decrypt
+    //Decrypt the sectors which are in at each poll in one go, while the card gets the next ones ready
     aes_use_keyslot(nandSlot);
-    aes(outbuf, outbuf, sectorCount * 0x200 / AES_BLOCK_SIZE, tmpCtr, AES_CTR_MODE, AES_INPUT_BE | AES_INPUT_NORMAL);
+    u32 decryptedSectors = 0;
+    while(true)
+    {
+        u32 readSectors;
+        bool finished = sdmmc_transfer_poll(&readSectors);
 
-    return result;
+        if(decryptedSectors < readSectors)
+        {
+            u8 *sectors = outbuf + decryptedSectors * 0x200;
+            aes(sectors, sectors, (readSectors - decryptedSectors) * 0x200 / AES_BLOCK_SIZE, tmpCtr, AES_CTR_MODE, AES_INPUT_BE | AES_INPUT_NORMAL);
+            decryptedSectors = readSectors;
+        }
+        else if(finished) break;
+    }
+
+    return sdmmc_transfer_wait();
+}
+
+u32 ctrNandRead(u32 sector, u32 sectorCount, u8 *outbuf)
+{
+    if(firmSource == FIRMWARE_SYSNAND) return ctrNandReadSectors(sector, sectorCount, outbuf);
+
+    //Like sdmmc_sdcard_readsectors, retry once if the SD clock has just been slowed down.
+    //The sectors which came in before the error are decrypted already, so read them all again
+    const mmcdevice *sd = getMMCDevice(1);
+    u32 clk = sd->clk,
+        ret = ctrNandReadSectors(sector, sectorCount, outbuf);
+
+    if(ret != 0 && sd->clk != clk) ret = ctrNandReadSectors(sector, sectorCount, outbuf);
+
+    return ret;
 }
 
+#ifndef BUILD_N3DS
 void set6x7xKeys(void)
 {
     const u8 __attribute__((aligned(4))) keyX0x25[AES_BLOCK_SIZE] = {0xCE, 0xE7, 0xD8, 0xAB, 0x30, 0xC0, 0x0D, 0xAE, 0x85, 0x0E, 0xF5, 0xE3, 0x82, 0xAC, 0x5A, 0xF3};
@@ -358,8 +476,11 @@ void set6x7xKeys(void)
     /* [3dbrew] The first 0x10-bytes are checked by the v6.0/v7.0 NATIVE_FIRM keyinit function, 
         when non-zero it clears this block and continues to do the key generation.
         Otherwise when this block was already all-zero, it immediately returns. */
+#ifndef CRYPTO_SOFTWARE
     memset32((void *)0x01FFCD00, 0, 0x10);
+#endif
 }
+#endif
 
 void decryptExeFs(u8 *inbuf)
 {
@@ -398,6 +519,7 @@ void decryptNusFirm(const u8 *inbuf, u8 *outbuf, u32 ncchSize)
     decryptExeFs(outbuf);
 }
 
+#ifndef BUILD_O3DS
 void kernel9Loader(u8 *arm9Section)
 {
     //Determine the kernel9loader version
@@ -465,29 +587,39 @@ void kernel9Loader(u8 *arm9Section)
     //Set >=9.6 KeyXs
     if(k9lVersion == 2)
     {
-        u8 __attribute__((aligned(4))) keyData[AES_BLOCK_SIZE] = {0xDD, 0xDA, 0xA4, 0xC6, 0x2C, 0xC4, 0x50, 0xE9, 0xDA, 0xB6, 0x9B, 0x0D, 0x9D, 0x2A, 0x21, 0x98};
-        u8 __attribute__((aligned(4))) decKey[sizeof(keyData)];
+        const u8 keyData[AES_BLOCK_SIZE] = {0xDD, 0xDA, 0xA4, 0xC6, 0x2C, 0xC4, 0x50, 0xE9, 0xDA, 0xB6, 0x9B, 0x0D, 0x9D, 0x2A, 0x21, 0x98};
+        u8 __attribute__((aligned(4))) keysData[0x20 - 0x19][AES_BLOCK_SIZE],
+                                       decKeys[0x20 - 0x19][AES_BLOCK_SIZE];
 
-        //Set keys 0x19..0x1F keyXs
-        aes_use_keyslot(0x11);
-        for(u8 slot = 0x19; slot < 0x20; slot++, keyData[0xF]++)
+        //Each keyslot's data only differs from the previous one in the last byte, decrypt them all in one go
+        for(u32 i = 0; i < sizeof(keysData) / AES_BLOCK_SIZE; i++)
         {
-            aes(decKey, keyData, 1, NULL, AES_ECB_DECRYPT_MODE, 0);
-            aes_setkey(slot, decKey, AES_KEYX, AES_INPUT_BE | AES_INPUT_NORMAL);
+            memcpy(keysData[i], keyData, AES_BLOCK_SIZE);
+            keysData[i][0xF] += i;
         }
+
+        aes_use_keyslot(0x11);
+        aes(decKeys, keysData, sizeof(keysData) / AES_BLOCK_SIZE, NULL, AES_ECB_DECRYPT_MODE, 0);
+
+        //Set keys 0x19..0x1F keyXs
+        for(u8 slot = 0x19; slot < 0x20; slot++)
+            aes_setkey(slot, decKeys[slot - 0x19], AES_KEYX, AES_INPUT_BE | AES_INPUT_NORMAL);
     }
 }
+#endif
 
 void computePinHash(u8 *outbuf, const u8 *inbuf)
 {
     u8 __attribute__((aligned(4))) cid[AES_BLOCK_SIZE];
     u8 __attribute__((aligned(4))) cipherText[AES_BLOCK_SIZE];
 
+#ifndef CRYPTO_SOFTWARE
     if(isA9lh && !didShaHashBackup)
     {
         memcpy(shaHashBackup, (void *)REG_SHA_HASH, sizeof(shaHashBackup));
         didShaHashBackup = true;
     }
+#endif
 
     sdmmc_get_cid(1, (u32 *)cid);
     aes_use_keyslot(4); //Console-unique keyslot whose keys are set by the ARM9 bootROM
@@ -497,5 +629,7 @@ void computePinHash(u8 *outbuf, const u8 *inbuf)
 
 void restoreShaHashBackup(void)
 {
+#ifndef CRYPTO_SOFTWARE
     if(didShaHashBackup) memcpy((void *)REG_SHA_HASH, shaHashBackup, sizeof(shaHashBackup));
+#endif
 }
\ No newline at end of file
@@ -102,14 +102,30 @@
 #define SHA_1_HASH_SIZE     (160 / 8)
 
 extern u32 emuOffset;
-extern bool isN3DS, isDevUnit, isA9lh;
+extern bool isA9lh;
 extern FirmwareSource firmSource;
 
 void ctrNandInit(void);
 u32 ctrNandRead(u32 sector, u32 sectorCount, u8 *outbuf);
-void set6x7xKeys(void);
 void decryptExeFs(u8 *inbuf);
 void decryptNusFirm(const u8 *inbuf, u8 *outbuf, u32 ncchSize);
+
+//Console-specific builds leave out the key data and the code of the other console's FIRMs
+#ifdef BUILD_N3DS
+#define set6x7xKeys() ((void)0)
+#else
+void set6x7xKeys(void);
+#endif
+#ifdef BUILD_O3DS
+#define kernel9Loader(arm9Section) ((void)(arm9Section))
+#else
 void kernel9Loader(u8 *arm9Section);
+#endif
 void computePinHash(u8 *outbuf, const u8 *inbuf);
-void restoreShaHashBackup(void);
\ No newline at end of file
+void restoreShaHashBackup(void);
+
+//Streaming hash on the SHA engine, for data that doesn't fit in memory at once (e.g. read from a file in chunks).
+//There is only one engine: nothing else may hash between sha_init and sha_final
+void sha_init(u32 mode);
+void sha_update(const void *src, u32 size);
+void sha_final(void *res);
\ No newline at end of file
@@ -48,8 +48,14 @@ bool loadSplash(void)
     initScreens();
     clearScreens(true, true, true);
 
-    if(isTopSplashValid) fileRead(fbs[1].top_left, topSplashPath, 0);
-    if(isBottomSplashValid) fileRead(fbs[1].bottom, bottomSplashPath, 0);
+    //Read the images in (cached) FCRAM and let the GPU move them to VRAM. The FIRM buffer is still unused at this point
+    u8 *splashBuffer = (u8 *)0x24000000;
+
+    isTopSplashValid = isTopSplashValid && fileRead(splashBuffer, topSplashPath, 0) == SCREEN_TOP_FBSIZE;
+    if(isTopSplashValid) gpuCopy(fbs[1].top_left, splashBuffer, SCREEN_TOP_FBSIZE);
+
+    isBottomSplashValid = isBottomSplashValid && fileRead(splashBuffer, bottomSplashPath, 0) == SCREEN_BOTTOM_FBSIZE;
+    if(isBottomSplashValid) gpuCopy(fbs[1].bottom, splashBuffer, SCREEN_BOTTOM_FBSIZE);
 
     swapFramebuffers(true);
 
@@ -28,7 +28,6 @@
 #define ROUND_TO_4MB(a) (((a) + 0x2000 - 1) & (~(0x2000 - 1)))
 
 extern u32 emuOffset;
-extern bool isN3DS;
 
 void locateEmuNand(u32 *emuHeader, FirmwareSource *nandType);
 void patchEmuNand(u8 *arm9Section, u32 arm9SectionSize, u8 *process9Offset, u32 process9Size, u32 emuHeader, u32 branchAdditive);
\ No newline at end of file
@@ -31,7 +31,11 @@
 
 void installArm9Handlers(void)
 {
-    memcpy((void *)0x01FF8000, arm9_exceptions_bin + 32, arm9_exceptions_bin_size - 32);
+    u32 arm9_exceptions_bin_size = LZ_DECOMPRESSED_SIZE(arm9_exceptions_bin_lz);
+    u32 arm9_exceptions_bin[(arm9_exceptions_bin_size + 3) / 4];
+    decompressLz(arm9_exceptions_bin, arm9_exceptions_bin_lz);
+
+    memcpy((void *)0x01FF8000, (u8 *)arm9_exceptions_bin + 32, arm9_exceptions_bin_size - 32);
 
     /* IRQHandler is at 0x08000000, but we won't handle it for some reasons
        svcHandler is at 0x08000010, but we won't handle svc either */
@@ -41,12 +45,17 @@ void installArm9Handlers(void)
     for(u32 i = 0; i < 4; i++)
     {
         *(vu32 *)(0x08000000 + offsets[i]) = 0xE51FF004;
-        *(vu32 *)(0x08000000 + offsets[i] + 4) = *((u32 *)arm9_exceptions_bin + 1 + i);
+        *(vu32 *)(0x08000000 + offsets[i] + 4) = arm9_exceptions_bin[1 + i];
     }
 }
 
 void installArm11Handlers(u32 *exceptionsPage, u32 stackAddress, u32 codeSetOffset)
 {
+    u32 arm11_exceptions_bin_size = LZ_DECOMPRESSED_SIZE(arm11_exceptions_bin_lz);
+    u32 arm11_exceptions_buffer[(arm11_exceptions_bin_size + 3) / 4];
+    u8 *arm11_exceptions_bin = (u8 *)arm11_exceptions_buffer;
+    decompressLz(arm11_exceptions_bin, arm11_exceptions_bin_lz);
+
     u32 *initFPU;
     for(initFPU = exceptionsPage; initFPU < (exceptionsPage + 0x400) && (initFPU[0] != 0xE59F0008 || initFPU[1] != 0xE5900000); initFPU++);
 
@@ -78,121 +87,167 @@ void installArm11Handlers(u32 *exceptionsPage, u32 stackAddress, u32 codeSetOffs
     }
 }
 
-void detectAndProcessExceptionDumps(void)
+static u32 displayExceptionDump(const ExceptionDumpHeader *dumpHeader)
 {
-    volatile ExceptionDumpHeader *dumpHeader = (volatile ExceptionDumpHeader *)0x25000000;
+    const u32 *regs = (const u32 *)((const u8 *)dumpHeader + sizeof(ExceptionDumpHeader));
+    const u8 *stackDump = (const u8 *)regs + dumpHeader->registerDumpSize + dumpHeader->codeDumpSize;
+    const u8 *additionalData = stackDump + dumpHeader->stackDumpSize;
 
-    if(dumpHeader->magic[0] == 0xDEADC0DE && dumpHeader->magic[1] == 0xDEADCAFE && (dumpHeader->processor == 9 || dumpHeader->processor == 11))
-    {
-        const vu32 *regs = (vu32 *)((vu8 *)dumpHeader + sizeof(ExceptionDumpHeader));
-        const vu8 *stackDump = (vu8 *)regs + dumpHeader->registerDumpSize + dumpHeader->codeDumpSize;
-        const vu8 *additionalData = stackDump + dumpHeader->stackDumpSize;
+    const char *handledExceptionNames[] = { 
+        "FIQ", "undefined instruction", "prefetch abort", "data abort"
+    };
 
-        const char *handledExceptionNames[] = { 
-            "FIQ", "undefined instruction", "prefetch abort", "data abort"
-        };
+    const char *specialExceptions[] = {
+        "(kernel panic)", "(svcBreak)"
+    };
 
-        const char *specialExceptions[] = {
-            "(kernel panic)", "(svcBreak)"
-        };
+    const char *registerNames[] = {
+        "R0", "R1", "R2", "R3", "R4", "R5", "R6", "R7", "R8", "R9", "R10", "R11", "R12",
+        "SP", "LR", "PC", "CPSR", "FPEXC"
+    };
 
-        const char *registerNames[] = {
-            "R0", "R1", "R2", "R3", "R4", "R5", "R6", "R7", "R8", "R9", "R10", "R11", "R12",
-            "SP", "LR", "PC", "CPSR", "FPEXC"
-        };
+    char hexString[] = "00000000";
 
-        char hexString[] = "00000000";
+    initScreens();
 
-        initScreens();
+    drawString("An exception occurred", true, 10, 10, COLOR_RED);
+    u32 posY = drawString(dumpHeader->processor == 11 ? "Processor:       ARM11 (core  )" : "Processor:       ARM9", true, 10, 30, COLOR_WHITE);
+    if(dumpHeader->processor == 11) drawCharacter('0' + dumpHeader->core, true, 10 + 29 * SPACING_X, 30, COLOR_WHITE);
 
-        drawString("An exception occurred", true, 10, 10, COLOR_RED);
-        u32 posY = drawString(dumpHeader->processor == 11 ? "Processor:       ARM11 (core  )" : "Processor:       ARM9", true, 10, 30, COLOR_WHITE);
-        if(dumpHeader->processor == 11) drawCharacter('0' + dumpHeader->core, true, 10 + 29 * SPACING_X, 30, COLOR_WHITE);
+    posY = drawString("Exception type:  ", true, 10, posY + SPACING_Y, COLOR_WHITE);
+    drawString(handledExceptionNames[dumpHeader->type], true, 10 + 17 * SPACING_X, posY, COLOR_WHITE);
 
-        posY = drawString("Exception type:  ", true, 10, posY + SPACING_Y, COLOR_WHITE);
-        drawString(handledExceptionNames[dumpHeader->type], true, 10 + 17 * SPACING_X, posY, COLOR_WHITE);
-
-        if(dumpHeader->type == 2)
+    if(dumpHeader->type == 2)
+    {
+        if((regs[16] & 0x20) == 0 && dumpHeader->codeDumpSize >= 4)
         {
-            if((regs[16] & 0x20) == 0 && dumpHeader->codeDumpSize >= 4)
-            {
-                u32 instr = *(vu32 *)(stackDump - 4);
-                if(instr == 0xE12FFF7E) drawString(specialExceptions[0], true, 10 + 32 * SPACING_X, posY, COLOR_WHITE);
-                else if(instr == 0xEF00003C) drawString(specialExceptions[1], true, 10 + 32 * SPACING_X, posY, COLOR_WHITE);
-            }
-            else if((regs[16] & 0x20) == 0 && dumpHeader->codeDumpSize >= 2)
-            {
-                u16 instr = *(vu16 *)(stackDump - 2);
-                if(instr == 0xDF3C) drawString(specialExceptions[1], true, 10 + 32 * SPACING_X, posY, COLOR_WHITE);
-            }
+            u32 instr = *(const u32 *)(stackDump - 4);
+            if(instr == 0xE12FFF7E) drawString(specialExceptions[0], true, 10 + 32 * SPACING_X, posY, COLOR_WHITE);
+            else if(instr == 0xEF00003C) drawString(specialExceptions[1], true, 10 + 32 * SPACING_X, posY, COLOR_WHITE);
         }
-
-        if(dumpHeader->processor == 11 && dumpHeader->additionalDataSize != 0)
+        else if((regs[16] & 0x20) == 0 && dumpHeader->codeDumpSize >= 2)
         {
-            char processName[] = "Current process:         ";
-            memcpy(processName + sizeof(processName) - 9, (void *)additionalData, 8);
-            posY = drawString(processName, true, 10, posY + SPACING_Y, COLOR_WHITE);
+            u16 instr = *(const u16 *)(stackDump - 2);
+            if(instr == 0xDF3C) drawString(specialExceptions[1], true, 10 + 32 * SPACING_X, posY, COLOR_WHITE);
         }
+    }
+
+    if(dumpHeader->processor == 11 && dumpHeader->additionalDataSize != 0)
+    {
+        char processName[] = "Current process:         ";
+        memcpy(processName + sizeof(processName) - 9, additionalData, 8);
+        posY = drawString(processName, true, 10, posY + SPACING_Y, COLOR_WHITE);
+    }
+
+    posY += SPACING_Y;
 
-        posY += SPACING_Y;
+    for(u32 i = 0; i < 17; i += 2)
+    {
+        posY = drawString(registerNames[i], true, 10, posY + SPACING_Y, COLOR_WHITE);
+        hexItoa(regs[i], hexString, 8);
+        drawString(hexString, true, 10 + 7 * SPACING_X, posY, COLOR_WHITE);
 
-        for(u32 i = 0; i < 17; i += 2)
+        if(i != 16 || dumpHeader->processor != 9)
         {
-            posY = drawString(registerNames[i], true, 10, posY + SPACING_Y, COLOR_WHITE);
-            hexItoa(regs[i], hexString, 8);
-            drawString(hexString, true, 10 + 7 * SPACING_X, posY, COLOR_WHITE);
-
-            if(i != 16 || dumpHeader->processor != 9)
-            {
-                drawString(registerNames[i + 1], true, 10 + 22 * SPACING_X, posY, COLOR_WHITE);
-                hexItoa(i == 16 ? regs[20] : regs[i + 1], hexString, 8);
-                drawString(hexString, true, 10 + 29 * SPACING_X, posY, COLOR_WHITE);
-            }
+            drawString(registerNames[i + 1], true, 10 + 22 * SPACING_X, posY, COLOR_WHITE);
+            hexItoa(i == 16 ? regs[20] : regs[i + 1], hexString, 8);
+            drawString(hexString, true, 10 + 29 * SPACING_X, posY, COLOR_WHITE);
         }
+    }
 
-        posY += SPACING_Y;
+    posY += SPACING_Y;
 
-        u32 mode = regs[16] & 0xF;
-        if(dumpHeader->type == 3 && (mode == 7 || mode == 11))
-            posY = drawString("Incorrect dump: failed to dump code and/or stack", true, 10, posY + SPACING_Y, COLOR_YELLOW) + SPACING_Y;
+    u32 mode = regs[16] & 0xF;
+    if(dumpHeader->type == 3 && (mode == 7 || mode == 11))
+        posY = drawString("Incorrect dump: failed to dump code and/or stack", true, 10, posY + SPACING_Y, COLOR_YELLOW) + SPACING_Y;
 
-        u32 posYBottom = drawString("Stack dump:", false, 10, 10, COLOR_WHITE) + SPACING_Y;
+    u32 posYBottom = drawString("Stack dump:", false, 10, 10, COLOR_WHITE) + SPACING_Y;
 
-        for(u32 line = 0; line < 19 && stackDump < additionalData; line++)
+    for(u32 line = 0; line < 19 && stackDump < additionalData; line++)
+    {
+        hexItoa(regs[13] + 8 * line, hexString, 8);
+        posYBottom = drawString(hexString, false, 10, posYBottom + SPACING_Y, COLOR_WHITE);
+        drawCharacter(':', false, 10 + 8 * SPACING_X, posYBottom, COLOR_WHITE);
+
+        for(u32 i = 0; i < 8 && stackDump < additionalData; i++, stackDump++)
         {
-            hexItoa(regs[13] + 8 * line, hexString, 8);
-            posYBottom = drawString(hexString, false, 10, posYBottom + SPACING_Y, COLOR_WHITE);
-            drawCharacter(':', false, 10 + 8 * SPACING_X, posYBottom, COLOR_WHITE);
-
-            for(u32 i = 0; i < 8 && stackDump < additionalData; i++, stackDump++)
-            {
-                char byteString[] = "00";
-                hexItoa(*stackDump, byteString, 2);
-                drawString(byteString, false, 10 + 10 * SPACING_X + 3 * i * SPACING_X, posYBottom, COLOR_WHITE);
-            }
+            char byteString[] = "00";
+            hexItoa(*stackDump, byteString, 2);
+            drawString(byteString, false, 10 + 10 * SPACING_X + 3 * i * SPACING_X, posYBottom, COLOR_WHITE);
         }
+    }
 
-        char path[42];
-        char fileName[] = "crash_dump_00000000.dmp";
-        const char *pathFolder = dumpHeader->processor == 9 ? "/puma/dumps/arm9" : "/puma/dumps/arm11";
+    return posY;
+}
 
-        findDumpFile(pathFolder, fileName);
-        memcpy(path, pathFolder, strlen(pathFolder) + 1);
-        concatenateStrings(path, "/");
-        concatenateStrings(path, fileName);
+static bool writeExceptionDump(const ExceptionDumpHeader *dumpHeader, char *path)
+{
+    char fileName[] = "crash_dump_00000000.dmp";
+    const char *pathFolder = dumpHeader->processor == 9 ? "/puma/dumps/arm9" : "/puma/dumps/arm11";
 
-        if(fileWrite((void *)dumpHeader, path, dumpHeader->totalSize))
+    findDumpFile(pathFolder, fileName);
+    memcpy(path, pathFolder, strlen(pathFolder) + 1);
+    concatenateStrings(path, "/");
+    concatenateStrings(path, fileName);
+
+    return fileWrite(dumpHeader, path, dumpHeader->totalSize);
+}
+
+void detectAndProcessExceptionDumps(bool headless)
+{
+    u32 posY = 0,
+        dumpCount = 0;
+    bool firstWritten = false;
+    char path[42];
+
+    /* Flush every pending slot in one go, showing the first dump found.
+       In headless mode, just write the dumps and let the boot continue */
+    for(u32 i = 0; i < DUMP_SLOT_COUNT; i++)
+    {
+        ExceptionDumpHeader *slot = (ExceptionDumpHeader *)(DUMP_SLOTS + i * DUMP_SLOT_SIZE);
+
+        if(slot->magic[0] == DUMP_SLOT_BUSY)
         {
-            posY = drawString("You can find a dump in the following file:", true, 10, posY + SPACING_Y, COLOR_WHITE);
-            posY = drawString(path, true, 10, posY + SPACING_Y, COLOR_WHITE) + SPACING_Y;
+            //The console rebooted before this dump was complete
+            slot->magic[0] = 0;
+            continue;
         }
-        else posY = drawString("Error writing the dump file", true, 10, posY + SPACING_Y, COLOR_RED);
 
-        drawString("Press any button to shutdown", true, 10, posY + SPACING_Y, COLOR_WHITE);
+        //FCRAM isn't cleared on reboot, don't trust any of the sizes
+        if(slot->magic[0] != 0xDEADC0DE || slot->magic[1] != 0xDEADCAFE || (slot->processor != 9 && slot->processor != 11) ||
+           slot->totalSize > DUMP_SLOT_SIZE || slot->registerDumpSize > DUMP_SLOT_SIZE || slot->codeDumpSize > DUMP_SLOT_SIZE ||
+           slot->stackDumpSize > DUMP_SLOT_SIZE || slot->additionalDataSize > DUMP_SLOT_SIZE ||
+           sizeof(ExceptionDumpHeader) + slot->registerDumpSize + slot->codeDumpSize + slot->stackDumpSize + slot->additionalDataSize > slot->totalSize)
+            continue;
 
-        memset32((void *)dumpHeader, 0, dumpHeader->totalSize);
+        if(dumpCount++ == 0 && !headless)
+        {
+            posY = displayExceptionDump(slot);
+            firstWritten = writeExceptionDump(slot, path);
+        }
+        else
+        {
+            char otherPath[42];
+            writeExceptionDump(slot, otherPath);
+        }
+
+        memset32(slot, 0, slot->totalSize);
+    }
+
+    if(dumpCount == 0 || headless) return;
 
-        waitInput();
-        mcuPowerOff();
+    if(firstWritten)
+    {
+        posY = drawString("You can find a dump in the following file:", true, 10, posY + SPACING_Y, COLOR_WHITE);
+        posY = drawString(path, true, 10, posY + SPACING_Y, COLOR_WHITE) + SPACING_Y;
     }
+    else posY = drawString("Error writing the dump file", true, 10, posY + SPACING_Y, COLOR_RED);
+
+    if(dumpCount > 1)
+        posY = drawString("More exceptions were dumped to /puma/dumps", true, 10, posY + SPACING_Y, COLOR_WHITE) + SPACING_Y;
+
+    drawString("Press any button to shutdown", true, 10, posY + SPACING_Y, COLOR_WHITE);
+
+    waitInput();
+    mcuPowerOff();
 }
\ No newline at end of file
@@ -27,6 +27,13 @@
 #define MAKE_BRANCH(src,dst)      (0xEA000000 | ((u32)((((u8 *)(dst) - (u8 *)(src)) >> 2) - 2) & 0xFFFFFF))
 #define MAKE_BRANCH_LINK(src,dst) (0xEB000000 | ((u32)((((u8 *)(dst) - (u8 *)(src)) >> 2) - 2) & 0xFFFFFF))
 
+//0x25000000 holds a ring of dump slots: the first one is the ARM9's, the others are claimed by the ARM11 cores.
+//The dumps in them are uncompressed v1.2 dumps, written out as they are
+#define DUMP_SLOTS              ((u8 *)0x25000000)
+#define DUMP_SLOT_SIZE          0x4400 //Big enough for a 16KB stack window, see exceptions/arm*/source/handlers.h
+#define DUMP_SLOT_COUNT         16
+#define DUMP_SLOT_BUSY          0xDEADBABE //Set by the ARM11 handlers while they write a dump
+
 typedef struct __attribute__((packed))
 {
     u32 magic[2];
@@ -44,4 +51,4 @@ typedef struct __attribute__((packed))
 
 void installArm9Handlers(void);
 void installArm11Handlers(u32 *exceptionsPage, u32 stackAddress, u32 codeSetOffset);
-void detectAndProcessExceptionDumps(void);
\ No newline at end of file
+void detectAndProcessExceptionDumps(bool headless);
\ No newline at end of file
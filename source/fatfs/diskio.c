@@ -10,6 +10,7 @@
 #include "diskio.h"		/* FatFs lower layer API */
 #include "sdmmc/sdmmc.h"
 #include "../crypto.h"
+#include "../iotrace.h"
 
 /* Definitions of physical drive number for each media */
 #define SDCARD        0
@@ -63,19 +64,21 @@ DRESULT disk_read (
 	UINT count		/* Number of sectors to read */
 )
 {
+        u32 result = 0;
+
+        ioTraceBegin();
         switch(pdrv)
         {
             case SDCARD:
-                if(sdmmc_sdcard_readsectors(sector, count, (BYTE *)buff))
-		    return RES_PARERR;
+                result = sdmmc_sdcard_readsectors(sector, count, (BYTE *)buff);
                 break;
             case CTRNAND:
-                if(ctrNandRead(sector, count, (BYTE *)buff))
-		    return RES_PARERR;
+                result = ctrNandRead(sector, count, (BYTE *)buff);
                 break;
         }
+        ioTraceEnd(pdrv, false, sector, count, result);
 
-        return RES_OK;
+        return result ? RES_PARERR : RES_OK;
 }
 
 
@@ -92,10 +95,13 @@ DRESULT disk_write (
 	UINT count			/* Number of sectors to write */
 )
 {
-        if(pdrv == SDCARD && sdmmc_sdcard_writesectors(sector, count, (BYTE *)buff))
-            return RES_PARERR;
+        if(pdrv != SDCARD) return RES_OK;
+
+        ioTraceBegin();
+        u32 result = sdmmc_sdcard_writesectors(sector, count, (BYTE *)buff);
+        ioTraceEnd(pdrv, true, sector, count, result);
 
-        return RES_OK;
+        return result ? RES_PARERR : RES_OK;
 }
 #endif
 
@@ -109,12 +115,12 @@ DRESULT disk_write (
 DRESULT disk_ioctl (
 	__attribute__((unused))
 	BYTE pdrv,		/* Physical drive nmuber (0..) */
-	__attribute__((unused))
 	BYTE cmd,		/* Control code */
 	__attribute__((unused))
 	void *buff		/* Buffer to send/receive control data */
 )
 {
-	return RES_PARERR;
+	//Writes are done by the time disk_write returns, there is nothing to flush
+	return cmd == CTRL_SYNC ? RES_OK : RES_PARERR;
 }
 #endif
@@ -28,6 +28,13 @@
 static struct mmcdevice handleNAND;
 static struct mmcdevice handleSD;
 
+#ifdef SDMMC_HOST_MODEL
+//Host builds (hostsim) provide a model of the controller and of the cards instead
+u16 sdmmc_read16(u16 reg);
+void sdmmc_write16(u16 reg, u16 val);
+u32 sdmmc_read32(u16 reg);
+void sdmmc_write32(u16 reg, u32 val);
+#else
 static inline u16 sdmmc_read16(u16 reg)
 {
     return *(vu16 *)(SDMMC_BASE + reg);
@@ -47,6 +54,7 @@ static inline void sdmmc_write32(u16 reg, u32 val)
 {
     *(vu32 *)(SDMMC_BASE + reg) = val;
 }
+#endif
 
 static inline void sdmmc_mask16(u16 reg, const u16 clear, const u16 set)
 {
@@ -82,16 +90,9 @@ static void inittarget(struct mmcdevice *ctx)
     else sdmmc_mask16(REG_SDOPT, 0x8000, 0);
 }
 
-static void __attribute__((noinline)) sdmmc_send_command(struct mmcdevice *ctx, u32 cmd, u32 args)
+static void sdmmc_start_command(struct mmcdevice *ctx, u32 cmd, u32 args)
 {
-    u32 getSDRESP = (cmd << 15) >> 31;
-    u16 flags = (cmd << 15) >> 31;
-    const int readdata = cmd & 0x20000;
-    const int writedata = cmd & 0x40000;
-
-    if(readdata || writedata)
-        flags |= TMIO_STAT0_DATAEND;
-
+    ctx->cmd = cmd;
     ctx->error = 0;
     while((sdmmc_read16(REG_SDSTATUS1) & TMIO_STAT1_CMD_BUSY)); //mmc working?
     sdmmc_write16(REG_SDIRMASK0, 0);
@@ -102,162 +103,259 @@ static void __attribute__((noinline)) sdmmc_send_command(struct mmcdevice *ctx,
     sdmmc_write16(REG_SDCMDARG0, args & 0xFFFF);
     sdmmc_write16(REG_SDCMDARG1, args >> 16);
     sdmmc_write16(REG_SDCMD, cmd & 0xFFFF);
+}
 
-    u32 size = ctx->size;
-    u8 *rDataPtr = ctx->rData;
-    const u8 *tDataPtr = ctx->tData;
+static void sdmmc_end_command(struct mmcdevice *ctx)
+{
+    ctx->stat0 = sdmmc_read16(REG_SDSTATUS0);
+    ctx->stat1 = sdmmc_read16(REG_SDSTATUS1);
+    sdmmc_write16(REG_SDSTATUS0, 0);
+    sdmmc_write16(REG_SDSTATUS1, 0);
 
-    bool rUseBuf = rDataPtr != NULL;
-    bool tUseBuf = tDataPtr != NULL;
+    if((ctx->cmd << 15) >> 31)
+    {
+        ctx->ret[0] = (u32)(sdmmc_read16(REG_SDRESP0) | (sdmmc_read16(REG_SDRESP1) << 16));
+        ctx->ret[1] = (u32)(sdmmc_read16(REG_SDRESP2) | (sdmmc_read16(REG_SDRESP3) << 16));
+        ctx->ret[2] = (u32)(sdmmc_read16(REG_SDRESP4) | (sdmmc_read16(REG_SDRESP5) << 16));
+        ctx->ret[3] = (u32)(sdmmc_read16(REG_SDRESP6) | (sdmmc_read16(REG_SDRESP7) << 16));
+    }
+}
 
-    u16 status0 = 0;
-    while(true)
+//Moves at most one block through the FIFO, returns true once the command is over
+static bool sdmmc_step_command(struct mmcdevice *ctx)
+{
+    u32 cmd = ctx->cmd;
+    u16 flags = (cmd << 15) >> 31;
+    const int readdata = cmd & 0x20000;
+    const int writedata = cmd & 0x40000;
+
+    if(readdata || writedata)
+        flags |= TMIO_STAT0_DATAEND;
+
+    vu16 status1 = sdmmc_read16(REG_SDSTATUS1);
+    vu16 ctl32 = sdmmc_read16(REG_DATACTL32);
+    if((ctl32 & 0x100))
     {
-        vu16 status1 = sdmmc_read16(REG_SDSTATUS1);
-        vu16 ctl32 = sdmmc_read16(REG_DATACTL32);
-        if((ctl32 & 0x100))
+        if(readdata)
         {
-            if(readdata)
+            if(ctx->rData != NULL)
             {
-                if(rUseBuf)
+                sdmmc_mask16(REG_SDSTATUS1, TMIO_STAT1_RXRDY, 0);
+                if(ctx->size != 0)
                 {
-                    sdmmc_mask16(REG_SDSTATUS1, TMIO_STAT1_RXRDY, 0);
-                    if(size > 0x1FF)
+                    //Gabriel Marcano: This implementation doesn't assume alignment.
+                    //I've removed the alignment check doen with former rUseBuf32 as a result
+                    //Blocks are 0x200 bytes, except for the status blocks of SD_Init
+                    u32 blockSize = ctx->size < 0x200 ? ctx->size : 0x200;
+                    u8 *rDataPtr = ctx->rData;
+                    for(u32 i = 0; i < blockSize; i += 4)
                     {
-                        //Gabriel Marcano: This implementation doesn't assume alignment.
-                        //I've removed the alignment check doen with former rUseBuf32 as a result
-                        for(int i = 0; i < 0x200; i += 4)
-                        {
-                            u32 data = sdmmc_read32(REG_SDFIFO32);
-                            *rDataPtr++ = data;
-                            *rDataPtr++ = data >> 8;
-                            *rDataPtr++ = data >> 16;
-                            *rDataPtr++ = data >> 24;
-                        }
-                        size -= 0x200;
+                        u32 data = sdmmc_read32(REG_SDFIFO32);
+                        *rDataPtr++ = data;
+                        *rDataPtr++ = data >> 8;
+                        *rDataPtr++ = data >> 16;
+                        *rDataPtr++ = data >> 24;
                     }
+                    ctx->rData = rDataPtr;
+                    ctx->size -= blockSize;
                 }
-
-                sdmmc_mask16(REG_DATACTL32, 0x800, 0);
             }
+
+            sdmmc_mask16(REG_DATACTL32, 0x800, 0);
         }
-        if(!(ctl32 & 0x200))
+    }
+    if(!(ctl32 & 0x200))
+    {
+        if(writedata)
         {
-            if(writedata)
+            if(ctx->tData != NULL)
             {
-                if(tUseBuf)
+                sdmmc_mask16(REG_SDSTATUS1, TMIO_STAT1_TXRQ, 0);
+                if(ctx->size > 0x1FF)
                 {
-                    sdmmc_mask16(REG_SDSTATUS1, TMIO_STAT1_TXRQ, 0);
-                    if(size > 0x1FF)
+                    const u8 *tDataPtr = ctx->tData;
+                    for(int i = 0; i < 0x200; i += 4)
                     {
-                        for(int i = 0; i < 0x200; i += 4)
-                        {
-                            u32 data = *tDataPtr++;
-                            data |= (u32)*tDataPtr++ << 8;
-                            data |= (u32)*tDataPtr++ << 16;
-                            data |= (u32)*tDataPtr++ << 24;
-                            sdmmc_write32(REG_SDFIFO32, data);
-                        }
-                        size -= 0x200;
+                        u32 data = *tDataPtr++;
+                        data |= (u32)*tDataPtr++ << 8;
+                        data |= (u32)*tDataPtr++ << 16;
+                        data |= (u32)*tDataPtr++ << 24;
+                        sdmmc_write32(REG_SDFIFO32, data);
                     }
+                    ctx->tData = tDataPtr;
+                    ctx->size -= 0x200;
                 }
-
-                sdmmc_mask16(REG_DATACTL32, 0x1000, 0);
             }
+
+            sdmmc_mask16(REG_DATACTL32, 0x1000, 0);
         }
-        if(status1 & TMIO_MASK_GW)
+    }
+    if(status1 & TMIO_MASK_GW)
+    {
+        ctx->error |= 4;
+        sdmmc_end_command(ctx);
+        return true;
+    }
+
+    if(!(status1 & TMIO_STAT1_CMD_BUSY))
+    {
+        u16 status0 = sdmmc_read16(REG_SDSTATUS0);
+        if(sdmmc_read16(REG_SDSTATUS0) & TMIO_STAT0_CMDRESPEND)
         {
-            ctx->error |= 4;
-            break;
+            ctx->error |= 0x1;
         }
-
-        if(!(status1 & TMIO_STAT1_CMD_BUSY))
+        if(status0 & TMIO_STAT0_DATAEND)
         {
-            status0 = sdmmc_read16(REG_SDSTATUS0);
-            if(sdmmc_read16(REG_SDSTATUS0) & TMIO_STAT0_CMDRESPEND)
-            {
-                ctx->error |= 0x1;
-            }
-            if(status0 & TMIO_STAT0_DATAEND)
-            {
-                ctx->error |= 0x2;
-            }
+            ctx->error |= 0x2;
+        }
 
-            if((status0 & flags) == flags)
-                break;
+        if((status0 & flags) == flags)
+        {
+            sdmmc_end_command(ctx);
+            return true;
         }
     }
-    ctx->stat0 = sdmmc_read16(REG_SDSTATUS0);
-    ctx->stat1 = sdmmc_read16(REG_SDSTATUS1);
-    sdmmc_write16(REG_SDSTATUS0, 0);
-    sdmmc_write16(REG_SDSTATUS1, 0);
 
-    if(getSDRESP != 0)
-    {
-        ctx->ret[0] = (u32)(sdmmc_read16(REG_SDRESP0) | (sdmmc_read16(REG_SDRESP1) << 16));
-        ctx->ret[1] = (u32)(sdmmc_read16(REG_SDRESP2) | (sdmmc_read16(REG_SDRESP3) << 16));
-        ctx->ret[2] = (u32)(sdmmc_read16(REG_SDRESP4) | (sdmmc_read16(REG_SDRESP5) << 16));
-        ctx->ret[3] = (u32)(sdmmc_read16(REG_SDRESP6) | (sdmmc_read16(REG_SDRESP7) << 16));
-    }
+    return false;
 }
 
-int __attribute__((noinline)) sdmmc_sdcard_writesectors(u32 sector_no, u32 numsectors, const u8 *in)
+static void __attribute__((noinline)) sdmmc_send_command(struct mmcdevice *ctx, u32 cmd, u32 args)
 {
-    if(handleSD.isSDHC == 0) sector_no <<= 9;
-    inittarget(&handleSD);
+    sdmmc_start_command(ctx, cmd, args);
+    while(!sdmmc_step_command(ctx));
+}
+
+//Sector transfer in progress, there can only be one at a time on the controller
+static struct mmcdevice *pendingDevice;
+static u32 pendingSectors;
+static bool pendingDone = true;
+
+static void sdmmc_submit(struct mmcdevice *ctx, u32 cmd, u32 sector_no, u32 numsectors, u8 *out, const u8 *in)
+{
+    //Finish the previous transfer first
+    if(!pendingDone) sdmmc_transfer_wait();
+
+    if(ctx->isSDHC == 0) sector_no <<= 9;
+    inittarget(ctx);
     sdmmc_write16(REG_SDSTOP, 0x100);
     sdmmc_write16(REG_SDBLKCOUNT32, numsectors);
     sdmmc_write16(REG_SDBLKLEN32, 0x200);
     sdmmc_write16(REG_SDBLKCOUNT, numsectors);
-    handleSD.tData = in;
-    handleSD.size = numsectors << 9;
-    sdmmc_send_command(&handleSD, 0x52C19, sector_no);
-    return geterror(&handleSD);
+    ctx->rData = out;
+    ctx->tData = in;
+    ctx->size = numsectors << 9;
+
+    pendingDevice = ctx;
+    pendingSectors = numsectors;
+    pendingDone = false;
+    sdmmc_start_command(ctx, cmd, sector_no);
+}
+
+void sdmmc_sdcard_readsectors_submit(u32 sector_no, u32 numsectors, u8 *out)
+{
+    sdmmc_submit(&handleSD, 0x33C12, sector_no, numsectors, out, NULL);
+}
+
+void sdmmc_nand_readsectors_submit(u32 sector_no, u32 numsectors, u8 *out)
+{
+    sdmmc_submit(&handleNAND, 0x33C12, sector_no, numsectors, out, NULL);
+}
+
+bool sdmmc_transfer_poll(u32 *doneSectors)
+{
+    struct mmcdevice *ctx = pendingDevice;
+
+    //Nothing was ever submitted
+    if(ctx == NULL)
+    {
+        if(doneSectors != NULL) *doneSectors = 0;
+        return true;
+    }
+
+    //Keep going as long as blocks are ready, return as soon as the controller has to wait for the card
+    while(!pendingDone)
+    {
+        u32 size = ctx->size;
+        pendingDone = sdmmc_step_command(ctx);
+        if(ctx->size == size) break;
+    }
+
+    if(doneSectors != NULL) *doneSectors = pendingSectors - (ctx->size >> 9);
+
+    return pendingDone;
+}
+
+int sdmmc_transfer_wait(void)
+{
+    struct mmcdevice *ctx = pendingDevice;
+
+    if(ctx == NULL) return 0;
+
+    while(!pendingDone) pendingDone = sdmmc_step_command(ctx);
+
+    if(ctx == &handleNAND) inittarget(&handleSD);
+
+    //Go back to the default speed clock if the card can't keep up with high speed
+    else if((ctx->stat1 & TMIO_STAT1_CRCFAIL) && (ctx->clk & 0xFF) == 0)
+        ctx->clk |= 1;
+
+    return geterror(ctx);
+}
+
+int __attribute__((noinline)) sdmmc_sdcard_writesectors(u32 sector_no, u32 numsectors, const u8 *in)
+{
+    if(numsectors > 1)
+    {
+        if(!pendingDone) sdmmc_transfer_wait();
+        inittarget(&handleSD);
+
+        //ACMD23: tell the card how many blocks are coming so it can pre-erase them.
+        //It's only a hint, skip it if the card didn't take the CMD55
+        sdmmc_send_command(&handleSD, 0x10437, handleSD.initarg << 0x10);
+        if(!(handleSD.error & 0x4)) sdmmc_send_command(&handleSD, 0x10457, numsectors);
+    }
+
+    u32 clk = handleSD.clk;
+    sdmmc_submit(&handleSD, 0x52C19, sector_no, numsectors, NULL, in);
+    int ret = sdmmc_transfer_wait();
+
+    //Retry once if the clock has just been slowed down
+    if(ret != 0 && handleSD.clk != clk)
+    {
+        sdmmc_submit(&handleSD, 0x52C19, sector_no, numsectors, NULL, in);
+        ret = sdmmc_transfer_wait();
+    }
+
+    return ret;
 }
 
 int __attribute__((noinline)) sdmmc_sdcard_readsectors(u32 sector_no, u32 numsectors, u8 *out)
 {
-    if(handleSD.isSDHC == 0) sector_no <<= 9;
-    inittarget(&handleSD);
-    sdmmc_write16(REG_SDSTOP, 0x100);
-    sdmmc_write16(REG_SDBLKCOUNT32, numsectors);
-    sdmmc_write16(REG_SDBLKLEN32, 0x200);
-    sdmmc_write16(REG_SDBLKCOUNT, numsectors);
-    handleSD.rData = out;
-    handleSD.size = numsectors << 9;
-    sdmmc_send_command(&handleSD, 0x33C12, sector_no);
-    return geterror(&handleSD);
+    u32 clk = handleSD.clk;
+    sdmmc_sdcard_readsectors_submit(sector_no, numsectors, out);
+    int ret = sdmmc_transfer_wait();
+
+    //Retry once if the clock has just been slowed down
+    if(ret != 0 && handleSD.clk != clk)
+    {
+        sdmmc_sdcard_readsectors_submit(sector_no, numsectors, out);
+        ret = sdmmc_transfer_wait();
+    }
+
+    return ret;
 }
 
 int __attribute__((noinline)) sdmmc_nand_readsectors(u32 sector_no, u32 numsectors, u8 *out)
 {
-    if(handleNAND.isSDHC == 0) sector_no <<= 9;
-    inittarget(&handleNAND);
-    sdmmc_write16(REG_SDSTOP, 0x100);
-    sdmmc_write16(REG_SDBLKCOUNT32, numsectors);
-    sdmmc_write16(REG_SDBLKLEN32, 0x200);
-    sdmmc_write16(REG_SDBLKCOUNT, numsectors);
-    handleNAND.rData = out;
-    handleNAND.size = numsectors << 9;
-    sdmmc_send_command(&handleNAND, 0x33C12, sector_no);
-    inittarget(&handleSD);
-    return geterror(&handleNAND);
+    sdmmc_nand_readsectors_submit(sector_no, numsectors, out);
+    return sdmmc_transfer_wait();
 }
 
 /*
 int __attribute__((noinline)) sdmmc_nand_writesectors(u32 sector_no, u32 numsectors, const u8 *in) //experimental
 {
-    if(handleNAND.isSDHC == 0) sector_no <<= 9;
-    inittarget(&handleNAND);
-    sdmmc_write16(REG_SDSTOP, 0x100);
-    sdmmc_write16(REG_SDBLKCOUNT32, numsectors);
-    sdmmc_write16(REG_SDBLKLEN32, 0x200);
-    sdmmc_write16(REG_SDBLKCOUNT, numsectors);
-    handleNAND.tData = in;
-    handleNAND.size = numsectors << 9;
-    sdmmc_send_command(&handleNAND, 0x52C19, sector_no);
-    inittarget(&handleSD);
-    return geterror(&handleNAND);
+    sdmmc_submit(&handleNAND, 0x52C19, sector_no, numsectors, NULL, in);
+    return sdmmc_transfer_wait();
 }
 */
 
@@ -291,28 +389,68 @@ static u32 calcSDSize(u8 *csd, int type)
     return result;
 }
 
+static u32 calcSDCCC(const u8 *csd)
+{
+    //Card command classes, CSD bits 95:84
+    return ((u32)csd[10] << 4) | (csd[9] >> 4);
+}
+
+//CMD6, the 64-byte switch function status is read into status
+static bool SD_Switch(u32 arg, u8 *status)
+{
+    sdmmc_write16(REG_SDSTOP, 0);
+    sdmmc_write16(REG_SDBLKCOUNT32, 1);
+    sdmmc_write16(REG_SDBLKLEN32, 64);
+    sdmmc_write16(REG_SDBLKCOUNT, 1);
+    sdmmc_write16(REG_SDBLKLEN, 64);
+    handleSD.rData = status;
+    handleSD.size = 64;
+    sdmmc_send_command(&handleSD, 0x31C06, arg);
+    sdmmc_write16(REG_SDBLKLEN32, 0x200);
+    sdmmc_write16(REG_SDBLKLEN, 0x200);
+
+    return !(handleSD.error & 0x4) && handleSD.size == 0;
+}
+
+static void SD_SetHighSpeed(u32 ccc)
+{
+    u8 __attribute__((aligned(4))) status[64];
+
+    //Cards without the switch command class (SD 1.0) don't know CMD6
+    if(!(ccc & 0x400)) return;
+
+    //Check that function 1 (high speed) of group 1 is supported, then switch to it
+    if(!SD_Switch(0x00FFFFF1, status) || !(status[13] & 0x2) || (status[16] & 0xF) != 1) return;
+    if(!SD_Switch(0x80FFFFF1, status) || (status[16] & 0xF) != 1) return;
+
+    //The card is in high speed mode 8 clocks after the status, go from HCLK/4 to HCLK/2
+    waitcycles(0x1000);
+    handleSD.clk &= ~0xFF;
+    setckl(handleSD.clk);
+}
+
 static void InitSD()
 {
-    *(vu16 *)0x10006100 &= 0xF7FFu; //SDDATACTL32
-    *(vu16 *)0x10006100 &= 0xEFFFu; //SDDATACTL32
-    *(vu16 *)0x10006100 |= 0x402u; //SDDATACTL32
-    *(vu16 *)0x100060D8 = (*(vu16 *)0x100060D8 & 0xFFDD) | 2;
-    *(vu16 *)0x10006100 &= 0xFFFFu; //SDDATACTL32
-    *(vu16 *)0x100060D8 &= 0xFFDFu; //SDDATACTL
-    *(vu16 *)0x10006104 = 512; //SDBLKLEN32
-    *(vu16 *)0x10006108 = 1; //SDBLKCOUNT32
-    *(vu16 *)0x100060E0 &= 0xFFFEu; //SDRESET
-    *(vu16 *)0x100060E0 |= 1u; //SDRESET
-    *(vu16 *)0x10006020 |= TMIO_MASK_ALL; //SDIR_MASK0
-    *(vu16 *)0x10006022 |= TMIO_MASK_ALL>>16; //SDIR_MASK1
-    *(vu16 *)0x100060FC |= 0xDBu; //SDCTL_RESERVED7
-    *(vu16 *)0x100060FE |= 0xDBu; //SDCTL_RESERVED8
-    *(vu16 *)0x10006002 &= 0xFFFCu; //SDPORTSEL
-    *(vu16 *)0x10006024 = 0x20;
-    *(vu16 *)0x10006028 = 0x40EE;
-    *(vu16 *)0x10006002 &= 0xFFFCu; ////SDPORTSEL
-    *(vu16 *)0x10006026 = 512; //SDBLKLEN
-    *(vu16 *)0x10006008 = 0; //SDSTOP
+    sdmmc_mask16(REG_DATACTL32, 0x800, 0);
+    sdmmc_mask16(REG_DATACTL32, 0x1000, 0);
+    sdmmc_mask16(REG_DATACTL32, 0, 0x402);
+    sdmmc_mask16(REG_DATACTL, 0x22, 2);
+    sdmmc_mask16(REG_DATACTL32, 0, 0);
+    sdmmc_mask16(REG_DATACTL, 0x20, 0);
+    sdmmc_write16(REG_SDBLKLEN32, 512);
+    sdmmc_write16(REG_SDBLKCOUNT32, 1);
+    sdmmc_mask16(REG_SDRESET, 1, 0);
+    sdmmc_mask16(REG_SDRESET, 0, 1);
+    sdmmc_mask16(REG_SDIRMASK0, 0, TMIO_MASK_ALL & 0xFFFF);
+    sdmmc_mask16(REG_SDIRMASK1, 0, TMIO_MASK_ALL >> 16);
+    sdmmc_mask16(0xFC, 0, 0xDB); //SDCTL_RESERVED7
+    sdmmc_mask16(0xFE, 0, 0xDB); //SDCTL_RESERVED8
+    sdmmc_mask16(REG_SDPORTSEL, 3, 0);
+    sdmmc_write16(REG_SDCLKCTL, 0x20);
+    sdmmc_write16(REG_SDOPT, 0x40EE);
+    sdmmc_mask16(REG_SDPORTSEL, 3, 0);
+    sdmmc_write16(REG_SDBLKLEN, 512);
+    sdmmc_write16(REG_SDSTOP, 0);
 }
 
 static int Nand_Init()
@@ -392,7 +530,7 @@ static int SD_Init()
     waitcycles(1u << 22); //Card needs a little bit of time to be detected, it seems FIXME test again to see what a good number is for the delay
 
     //If not inserted
-    if(!(*((vu16 *)(SDMMC_BASE + REG_SDSTATUS0)) & TMIO_STAT0_SIGSTATE)) return 5;
+    if(!(sdmmc_read16(REG_SDSTATUS0) & TMIO_STAT0_SIGSTATE)) return 5;
 
     sdmmc_send_command(&handleSD, 0, 0);
     sdmmc_send_command(&handleSD, 0x10408, 0x1AA);
@@ -427,6 +565,7 @@ static int SD_Init()
     if((handleSD.error & 0x4)) return -3;
 
     handleSD.total_size = calcSDSize((u8*)&handleSD.ret[0], -1);
+    u32 ccc = calcSDCCC((u8*)&handleSD.ret[0]);
     handleSD.clk = 1;
     setckl(1);
 
@@ -447,6 +586,8 @@ static int SD_Init()
     if((handleSD.error & 0x4)) return -8;
     handleSD.clk |= 0x200;
 
+    SD_SetHighSpeed(ccc);
+
     return 0;
 }
 
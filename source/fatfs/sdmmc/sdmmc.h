@@ -89,6 +89,7 @@ typedef struct mmcdevice {
     u32 devicenumber;
     u32 total_size; //size in sectors of the device
     u32 res;
+    u32 cmd; //last command sent
 } mmcdevice;
 
 void sdmmc_sdcard_init();
@@ -97,4 +98,11 @@ int sdmmc_sdcard_writesectors(u32 sector_no, u32 numsectors, const u8 *in);
 int sdmmc_nand_readsectors(u32 sector_no, u32 numsectors, u8 *out);
 //int sdmmc_nand_writesectors(u32 sector_no, u32 numsectors, const u8 *in);
 void sdmmc_get_cid(bool isNand, u32 *info);
+
+//Asynchronous reads: the transfer only progresses while sdmmc_transfer_poll or sdmmc_transfer_wait are being called,
+//the CPU can do other work (e.g. on the sectors already read) in between
+void sdmmc_sdcard_readsectors_submit(u32 sector_no, u32 numsectors, u8 *out);
+void sdmmc_nand_readsectors_submit(u32 sector_no, u32 numsectors, u8 *out);
+bool sdmmc_transfer_poll(u32 *doneSectors); //returns true once the transfer is over, doneSectors is how many sectors are in the buffer
+int sdmmc_transfer_wait(void); //returns what the synchronous functions would have returned
 mmcdevice *getMMCDevice(int drive);
\ No newline at end of file
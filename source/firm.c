@@ -35,6 +35,8 @@
 #include "screen.h"
 #include "buttons.h"
 #include "pin.h"
+#include "worker.h"
+#include "iotrace.h"
 #include "../build/bundled.h"
 
 extern u16 launchedFirmTidLow[8]; //Defined in start.s
@@ -43,10 +45,12 @@ static firmHeader *firm = (firmHeader *)0x24000000;
 static const firmSectionHeader *section;
 
 u32 emuOffset;
-bool isN3DS,
-     isDevUnit,
-     isA9lh,
+bool isA9lh,
      isFirmlaunch;
+#if !defined(BUILD_O3DS) && !defined(BUILD_N3DS)
+bool isN3DS,
+     isDevUnit;
+#endif
 CfgData configData;
 FirmwareSource firmSource;
 
@@ -58,11 +62,17 @@ void main(void)
     FirmwareSource nandType;
     ConfigurationStatus needConfig;
 
+#if defined(BUILD_O3DS) || defined(BUILD_N3DS)
+    //Make sure this console-specific build is running on the right console
+    if((PDN_MPCORE_CFG == 7) != isN3DS || CFG_UNITINFO != 0)
+        error(isN3DS ? "This build of Puma33DS is for retail N3DS only." : "This build of Puma33DS is for retail O3DS only.");
+#else
     //Detect the console being used
     isN3DS = PDN_MPCORE_CFG == 7;
 
     //Detect dev units
     isDevUnit = CFG_UNITINFO != 0;
+#endif
 
     //Mount filesystems. CTRNAND will be mounted only if/when needed
     mountFs();
@@ -94,7 +104,7 @@ void main(void)
         //Determine if booting with A9LH
         isA9lh = !PDN_SPI_CNT;
 
-        if(devMode != 0 && isA9lh) detectAndProcessExceptionDumps();
+        if(devMode != 0 && isA9lh) detectAndProcessExceptionDumps(devMode == 3);
 
         //Get pressed buttons
         u32 pressed = HID_PAD;
@@ -250,6 +260,9 @@ void main(void)
     bool loadFromSd = CONFIG(LOADSDFIRMSANDMODULES);
     u32 firmVersion = loadFirm(&firmType, firmSource, loadFromSd);
 
+    //The ARM11 is idle until the FIRM is launched, give it some work
+    startArm11Worker();
+
     switch(firmType)
     {
         case NATIVE_FIRM:
@@ -308,7 +321,7 @@ static inline u32 loadFirm(FirmwareType *firmType, FirmwareSource firmSource, bo
 
     if(loadFromSd || mustLoadFromSd)
     {
-        u32 firmSize = fileRead(firm, *firmType == NATIVE_FIRM1X2X ? firmwareFiles[0] : firmwareFiles[(u32)*firmType], 0x400000);
+        u32 firmSize = fileReadVerified(firm, *firmType == NATIVE_FIRM1X2X ? firmwareFiles[0] : firmwareFiles[(u32)*firmType], 0x400000);
 
         if(firmSize > 0)
         {
@@ -316,7 +329,7 @@ static inline u32 loadFirm(FirmwareType *firmType, FirmwareSource firmSource, bo
             {
                 u8 cetk[0xA50];
 
-                if(fileRead(cetk, *firmType == NATIVE_FIRM1X2X ? cetkFiles[0] : cetkFiles[(u32)*firmType], sizeof(cetk)) == sizeof(cetk))
+                if(fileReadVerified(cetk, *firmType == NATIVE_FIRM1X2X ? cetkFiles[0] : cetkFiles[(u32)*firmType], sizeof(cetk)) == sizeof(cetk))
                     decryptNusFirm(cetk, (u8 *)firm, firmSize);
                 else error("The firmware.bin in /puma is encrypted\nor corrupted.");
             }
@@ -353,10 +366,8 @@ static inline void patchNativeFirm(u32 firmVersion, FirmwareSource nandType, u32
     //Sets the 7.x NCCH KeyX and the 6.x gamecard save data KeyY on >= 6.0 O3DS FIRMs, if not using A9LH or a dev unit
     else if(!isA9lh && firmVersion >= 0x29 && !isDevUnit) set6x7xKeys();
 
-    //Find the Process9 .code location, size and memory address
-    u32 process9Size,
-        process9MemAddr;
-    u8 *process9Offset = getProcess9(arm9Section + 0x15000, section[2].size - 0x15000, &process9Size, &process9MemAddr);
+    //Look for Process9 on the ARM11 while the ARM9 parses Kernel11
+    u32 process9Search = arm11WorkerSearch(arm9Section + 0x15000, "ess9", section[2].size - 0x15000, 4);
 
     //Find Kernel11 SVC table and handler, exceptions page and free space locations
     u32 baseK11VA;
@@ -365,6 +376,11 @@ static inline void patchNativeFirm(u32 firmVersion, FirmwareSource nandType, u32
         *arm11ExceptionsPage,
         *arm11SvcTable = getKernel11Info(arm11Section1, section[1].size, &baseK11VA, &freeK11Space, &arm11SvcHandler, &arm11ExceptionsPage);
 
+    //Find the Process9 .code location, size and memory address
+    u32 process9Size,
+        process9MemAddr;
+    u8 *process9Offset = getProcess9(arm11WorkerWait(process9Search), &process9Size, &process9MemAddr);
+
     //Apply signature patches
     patchSignatureChecks(process9Offset, process9Size);
 
@@ -481,27 +497,20 @@ static inline void copySection0AndInjectSystemModules(FirmwareType firmType, boo
             concatenateStrings(fileName, moduleName);
             concatenateStrings(fileName, ext);
 
-            fileSize = fileRead(dst, fileName, 2 * srcModuleSize);
+            fileSize = fileReadVerified(dst, fileName, 2 * srcModuleSize);
         }
         else fileSize = 0;
 
         if(fileSize > 0) dstModuleSize = fileSize;
+        else if(firmType == NATIVE_FIRM && memcmp(moduleName, "loader", 6) == 0)
+        {
+            dstModuleSize = LZ_DECOMPRESSED_SIZE(injector_bin_lz);
+            arm11WorkerDecompress(dst, injector_bin_lz);
+        }
         else
         {
-            const u8 *module;
-
-            if(firmType == NATIVE_FIRM && memcmp(moduleName, "loader", 6) == 0)
-            {
-                module = injector_bin;
-                dstModuleSize = injector_bin_size;
-            }
-            else
-            {
-                module = src;
-                dstModuleSize = srcModuleSize;
-            }
-
-            memcpy(dst, module, dstModuleSize);
+            dstModuleSize = srcModuleSize;
+            arm11WorkerCopy(dst, src, dstModuleSize);
         }
     }
 }
@@ -517,9 +526,20 @@ static inline void launchFirm(FirmwareType firmType, bool loadFromSd)
     }
     else sectionNum = 0;
 
-    //Copy FIRM sections to respective memory locations
+    //Copy FIRM sections to respective memory locations, leaving the ones the ARM11 can reach to it
     for(; sectionNum < 4 && section[sectionNum].size != 0; sectionNum++)
-        memcpy(section[sectionNum].address, (u8 *)firm + section[sectionNum].offset, section[sectionNum].size);
+    {
+        if(ARM11_CAN_ACCESS(section[sectionNum].address))
+            arm11WorkerCopy(section[sectionNum].address, (u8 *)firm + section[sectionNum].offset, section[sectionNum].size);
+        else
+            memcpy(section[sectionNum].address, (u8 *)firm + section[sectionNum].offset, section[sectionNum].size);
+    }
+
+    //Nothing else is read from the SD card past this point
+    ioTraceDump();
+
+    //Wait for all the copies to be done
+    stopArm11Worker();
 
     //Determine the ARM11 entry to use
     vu32 *arm11;
@@ -28,6 +28,7 @@
 #include "screen.h"
 #include "fatfs/ff.h"
 #include "buttons.h"
+#include "utils.h"
 #include "../build/bundled.h"
 
 static FATFS sdFs,
@@ -61,6 +62,111 @@ u32 getFileSize(const char *path)
     return fileRead(NULL, path, 0);
 }
 
+static char manifest[0x1001];
+static bool manifestLoaded = false;
+
+static inline int hexValue(char c)
+{
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool getManifestHash(const char *path, u8 *hash)
+{
+    if(!manifestLoaded)
+    {
+        if(getFileSize(MANIFEST_PATH) > sizeof(manifest) - 1)
+            error("The integrity manifest in /puma is too big.");
+
+        manifest[fileRead(manifest, MANIFEST_PATH, sizeof(manifest) - 1)] = 0;
+        manifestLoaded = true;
+    }
+
+    //Entries are relative to /puma, like the output of sha256sum run from there
+    const char *name = path + sizeof("/puma/") - 1;
+    u32 nameLength = strlen(name);
+
+    for(const char *line = manifest; *line != 0;)
+    {
+        const char *end = line;
+        while(*end != 0 && *end != '\n') end++;
+
+        //"<hash>  <name>" or "<hash> *<name>"
+        const char *entry = line + 2 * SHA_256_HASH_SIZE + 2;
+        u32 entryLength = end - line >= 2 * SHA_256_HASH_SIZE + 2 ? end - entry : 0;
+        if(entryLength > 0 && entry[entryLength - 1] == '\r') entryLength--;
+
+        if(entryLength == nameLength && line[2 * SHA_256_HASH_SIZE] == ' ' && (entry[-1] == ' ' || entry[-1] == '*') &&
+           memcmp(entry, name, nameLength) == 0)
+        {
+            for(u32 i = 0; i < SHA_256_HASH_SIZE; i++)
+            {
+                int high = hexValue(line[2 * i]),
+                    low = hexValue(line[2 * i + 1]);
+
+                if(high < 0 || low < 0) return false;
+                hash[i] = (u8)((high << 4) | low);
+            }
+
+            return true;
+        }
+
+        line = *end != 0 ? end + 1 : end;
+    }
+
+    return false;
+}
+
+u32 fileReadVerified(void *dest, const char *path, u32 maxSize)
+{
+    u8 __attribute__((aligned(4))) expectedHash[SHA_256_HASH_SIZE],
+                                   hash[SHA_256_HASH_SIZE];
+
+    if(!getManifestHash(path, expectedHash)) return fileRead(dest, path, maxSize);
+
+    FIL file;
+    u32 ret = 0,
+        size = 0;
+
+    if(f_open(&file, path, FA_READ) == FR_OK)
+    {
+        size = f_size(&file);
+        if(!(maxSize > 0 && size > maxSize))
+        {
+            //Hash each chunk as soon as it has been read, rather than going through the whole file again afterwards
+            u8 *dest8 = (u8 *)dest;
+            sha_init(SHA_256_MODE);
+
+            while(ret < size)
+            {
+                unsigned int read;
+                u32 chunkSize = size - ret > VERIFY_CHUNK_SIZE ? VERIFY_CHUNK_SIZE : size - ret;
+
+                if(f_read(&file, dest8 + ret, chunkSize, &read) != FR_OK || read == 0) break;
+
+                sha_update(dest8 + ret, read);
+                ret += read;
+            }
+
+            sha_final(hash);
+        }
+        f_close(&file);
+    }
+
+    //A file in the manifest which can't be fully read is as bad as a corrupted one
+    if(ret == 0 || ret != size || memcmp(hash, expectedHash, sizeof(hash)) != 0)
+    {
+        char message[80] = "The file ";
+        concatenateStrings(message, path);
+        concatenateStrings(message, "\nis missing or corrupted.");
+        error(message);
+    }
+
+    return ret;
+}
+
 bool fileWrite(const void *buffer, const char *path, u32 size)
 {
     FIL file;
@@ -69,12 +175,12 @@ bool fileWrite(const void *buffer, const char *path, u32 size)
 
     if(result == FR_OK)
     {
-        unsigned int written;
-        f_write(&file, buffer, size, &written);
-        f_truncate(&file);
-        f_close(&file);
+        unsigned int written = 0;
+        result = f_write(&file, buffer, size, &written);
+        if(result == FR_OK) result = f_truncate(&file);
+        FRESULT closeResult = f_close(&file);
 
-        return true;
+        return result == FR_OK && closeResult == FR_OK && written == size;
     }
 
     if(result == FR_NO_PATH)
@@ -128,7 +234,7 @@ void loadPayload(u32 pressed)
         u32 *loaderAddress = (u32 *)0x24FFFF00;
         u8 *payloadAddress = (u8 *)0x24F00000;
 
-        memcpy(loaderAddress, loader_bin, loader_bin_size);
+        u32 loader_bin_size = decompressLz(loaderAddress, loader_bin_lz);
 
         concatenateStrings(path, "/");
         concatenateStrings(path, info.altname);
@@ -26,11 +26,15 @@
 
 #define PATTERN(a) a "_*.bin"
 
-extern bool isN3DS, isA9lh;
+#define MANIFEST_PATH       "/puma/manifest.txt"
+#define VERIFY_CHUNK_SIZE   0x10000
+
+extern bool isA9lh;
 
 void mountFs(void);
 u32 fileRead(void *dest, const char *path, u32 maxSize);
 u32 getFileSize(const char *path);
+u32 fileReadVerified(void *dest, const char *path, u32 maxSize);
 bool fileWrite(const void *buffer, const char *path, u32 size);
 void fileDelete(const char *path);
 void loadPayload(u32 pressed);
@@ -0,0 +1,92 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+#include "iotrace.h"
+#include "fs.h"
+#include "utils.h"
+
+#ifdef IOTRACE
+
+static IoTraceEntry entries[IOTRACE_ENTRIES];
+static u32 totalEntries = 0;
+static bool dumping = false;
+
+//Timers 0 and 1 cascaded into a 32-bit 67MHz counter, the same way chrono sets them up
+void ioTraceBegin(void)
+{
+    REG_TIMER_CNT(0) = 0;
+    REG_TIMER_CNT(1) = 4;
+    REG_TIMER_VAL(0) = 0;
+    REG_TIMER_VAL(1) = 0;
+    REG_TIMER_CNT(0) = 0x80;
+    REG_TIMER_CNT(1) = 0x84;
+}
+
+void ioTraceEnd(u32 drive, bool isWrite, u32 sector, u32 count, u32 result)
+{
+    u32 high, low;
+    do
+    {
+        high = REG_TIMER_VAL(1);
+        low = REG_TIMER_VAL(0);
+    }
+    while(high != REG_TIMER_VAL(1));
+
+    REG_TIMER_CNT(0) &= ~0x80;
+    REG_TIMER_CNT(1) &= ~0x80;
+
+    //Don't trace the dump itself
+    if(dumping) return;
+
+    IoTraceEntry *entry = &entries[totalEntries++ % IOTRACE_ENTRIES];
+    entry->sector = sector;
+    entry->count = count;
+    entry->ticks = (high << 16) | low;
+    entry->drive = (u8)drive;
+    entry->isWrite = isWrite ? 1 : 0;
+    entry->result = (u16)result;
+}
+
+void ioTraceDump(void)
+{
+    static u8 buffer[sizeof(IoTraceHeader) + sizeof(entries)];
+
+    IoTraceHeader *header = (IoTraceHeader *)buffer;
+    u32 entryCount = totalEntries < IOTRACE_ENTRIES ? totalEntries : IOTRACE_ENTRIES;
+
+    header->magic = IOTRACE_MAGIC;
+    header->version = IOTRACE_VERSION;
+    header->entrySize = sizeof(IoTraceEntry);
+    header->totalEntries = totalEntries;
+    header->entryCount = entryCount;
+
+    //Oldest entry first
+    IoTraceEntry *out = (IoTraceEntry *)(buffer + sizeof(IoTraceHeader));
+    for(u32 i = totalEntries - entryCount; i < totalEntries; i++)
+        *out++ = entries[i % IOTRACE_ENTRIES];
+
+    dumping = true;
+    fileWrite(buffer, IOTRACE_PATH, sizeof(IoTraceHeader) + entryCount * sizeof(IoTraceEntry));
+    dumping = false;
+}
+
+#endif
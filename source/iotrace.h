@@ -0,0 +1,64 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   Records the sector requests FatFs makes during boot (make iotrace), dumped to /puma/iotrace.bin before the FIRM is launched.
+*   iotrace/iotrace_analyzer.py reads the dumps.
+*/
+
+#pragma once
+
+#include "types.h"
+
+#define IOTRACE_PATH        "/puma/iotrace.bin"
+#define IOTRACE_MAGIC       0x52544F49 //"IOTR"
+#define IOTRACE_VERSION     1
+#define IOTRACE_ENTRIES     512 //Only the last ones are kept
+
+typedef struct IoTraceEntry
+{
+    u32 sector;
+    u32 count;
+    u32 ticks; //67MHz timer ticks the request took
+    u8 drive;
+    u8 isWrite;
+    u16 result;
+} IoTraceEntry;
+
+typedef struct IoTraceHeader
+{
+    u32 magic;
+    u16 version;
+    u16 entrySize;
+    u32 totalEntries; //Including the ones which got overwritten
+    u32 entryCount;
+} IoTraceHeader;
+
+#ifdef IOTRACE
+void ioTraceBegin(void);
+void ioTraceEnd(u32 drive, bool isWrite, u32 sector, u32 count, u32 result);
+void ioTraceDump(void);
+#else
+#define ioTraceBegin()
+#define ioTraceEnd(drive, isWrite, sector, count, result)
+#define ioTraceDump()
+#endif
@@ -23,6 +23,7 @@
 /*
 *   Boyer-Moore Horspool algorithm adapted from http://www-igm.univ-mlv.fr/~lecroq/string/node18.html#SECTION00180
 *   memcpy, memset32 and memcmp adapted from https://github.com/mid-kid/CakesForeveryWan/blob/557a8e8605ab3ee173af6497486e8f22c261d0e2/source/memfuncs.c
+*   decompressLz implements the GBA BIOS LZ77 format (type 0x10), as produced by gbalzss
 */
 
 #include "memory.h"
@@ -80,4 +81,34 @@ u8 *memsearch(u8 *startPos, const void *pattern, u32 size, u32 patternSize)
     }
 
     return NULL;
+}
+
+u32 decompressLz(void *dest, const void *src)
+{
+    const u8 *in = (const u8 *)src + 4;
+    u8 *out = (u8 *)dest;
+    u32 size = LZ_DECOMPRESSED_SIZE(src);
+    const u8 *end = out + size;
+
+    while(out < end)
+    {
+        u8 flags = *in++;
+
+        for(u32 i = 0; i < 8 && out < end; i++, flags <<= 1)
+        {
+            //Back-reference: 4 bits of length, 12 bits of displacement
+            if(flags & 0x80)
+            {
+                u32 length = (in[0] >> 4) + 3,
+                    displacement = (((in[0] & 0xF) << 8) | in[1]) + 1;
+                in += 2;
+
+                for(; length > 0 && out < end; length--, out++)
+                    *out = *(out - displacement);
+            }
+            else *out++ = *in++;
+        }
+    }
+
+    return size;
 }
\ No newline at end of file
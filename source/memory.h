@@ -23,13 +23,17 @@
 /*
 *   Boyer-Moore Horspool algorithm adapted from http://www-igm.univ-mlv.fr/~lecroq/string/node18.html#SECTION00180
 *   memcpy, memset32 and memcmp adapted from https://github.com/mid-kid/CakesForeveryWan/blob/557a8e8605ab3ee173af6497486e8f22c261d0e2/source/memfuncs.c
+*   decompressLz implements the GBA BIOS LZ77 format (type 0x10), as produced by gbalzss
 */
 
 #pragma once
 
 #include "types.h"
 
+#define LZ_DECOMPRESSED_SIZE(src) (*(const u32 *)(src) >> 8)
+
 void memcpy(void *dest, const void *src, u32 size);
 void memset32(void *dest, u32 filler, u32 size);
 int memcmp(const void *buf1, const void *buf2, u32 size);
-u8 *memsearch(u8 *startPos, const void *pattern, u32 size, u32 patternSize);
\ No newline at end of file
+u8 *memsearch(u8 *startPos, const void *pattern, u32 size, u32 patternSize);
+u32 decompressLz(void *dest, const void *src);
\ No newline at end of file
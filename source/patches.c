@@ -30,10 +30,9 @@
 #include "config.h"
 #include "../build/bundled.h"
 
-u8 *getProcess9(u8 *pos, u32 size, u32 *process9Size, u32 *process9MemAddr)
+u8 *getProcess9(u8 *off, u32 *process9Size, u32 *process9MemAddr)
 {
-    u8 *off = memsearch(pos, "ess9", size, 4);
-
+    //off points to the "ess9" part of the Process9 NCCH header product code
     *process9Size = *(u32 *)(off - 0x60) * 0x200;
     *process9MemAddr = *(u32 *)(off + 0xC);
 
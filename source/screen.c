@@ -40,6 +40,7 @@
 #include "memory.h"
 #include "cache.h"
 #include "i2c.h"
+#include "worker.h"
 
 vu32 *const arm11Entry = (vu32 *)BRAHMA_ARM11_ENTRY;
 static const u32 brightness[4] = {0x5F, 0x4C, 0x39, 0x26};
@@ -56,7 +57,7 @@ void  __attribute__((naked)) arm11Stub(void)
     ((void (*)())*arm11Entry)();
 }
         
-static void invokeArm11Function(void (*func)())
+void startArm11Function(void (*func)())
 {
     static bool hasCopiedStub = false;
     if(!hasCopiedStub)
@@ -67,10 +68,23 @@ static void invokeArm11Function(void (*func)())
     }
 
     *arm11Entry = (u32)func;
+}
+
+void waitForArm11Function(void)
+{
     while(*arm11Entry);
     *arm11Entry = ARM11_STUB_ADDRESS;
 }
 
+static void invokeArm11Function(void (*func)())
+{
+    //The ARM11 can only run one function at a time
+    stopArm11Worker();
+
+    startArm11Function(func);
+    waitForArm11Function();
+}
+
 void deinitScreens(void)
 {
     void __attribute__((naked)) ARM11(void)
@@ -187,6 +201,52 @@ void clearScreens(bool clearTop, bool clearBottom, bool clearAlternate)
     invokeArm11Function(ARM11);
 }
 
+void gpuCopy(void *dst, const void *src, u32 size)
+{
+    //The engine moves whole 16-byte units between 8-byte aligned addresses, copy anything else on the ARM9
+    if(size == 0 || size > GPU_COPY_MAX_SIZE || (size & 0xF) != 0 || (((u32)dst | (u32)src) & 7) != 0)
+    {
+        memcpy(dst, src, size);
+        return;
+    }
+
+    static void *dstTmp;
+    static const void *srcTmp;
+    static u32 sizeTmp;
+    dstTmp = dst;
+    srcTmp = src;
+    sizeTmp = size;
+
+    void __attribute__((naked)) ARM11(void)
+    {
+        //Disable interrupts
+        __asm(".word 0xF10C01C0");
+
+        //Setting up a raw copy using the GPU display transfer engine (TextureCopy mode)
+
+        vu32 *REGs_PPF = (vu32 *)0x10400C00;
+
+        REGs_PPF[0] = (u32)srcTmp >> 3; //Input address
+        REGs_PPF[1] = (u32)dstTmp >> 3; //Output address
+        REGs_PPF[4] = 1 << 3; //TextureCopy
+        REGs_PPF[8] = sizeTmp; //Total size
+        REGs_PPF[9] = sizeTmp >> 4; //Input line width in 16 bytes units, no gap
+        REGs_PPF[10] = sizeTmp >> 4; //Output line width in 16 bytes units, no gap
+        REGs_PPF[6] = 1; //Start
+
+        while(REGs_PPF[6] & 1);
+
+        WAIT_FOR_ARM9();
+    }
+
+    //The GPU reads from memory, not from the ARM9 data cache
+    flushDCacheRange((void *)src, size);
+    flushDCacheRange(&dstTmp, 4);
+    flushDCacheRange(&srcTmp, 4);
+    flushDCacheRange(&sizeTmp, 4);
+    invokeArm11Function(ARM11);
+}
+
 void initScreens(void)
 {
     void __attribute__((naked)) initSequence(void)
@@ -39,6 +39,7 @@
 #define SCREEN_HEIGHT        240
 #define SCREEN_TOP_FBSIZE    (3 * SCREEN_TOP_WIDTH * SCREEN_HEIGHT)
 #define SCREEN_BOTTOM_FBSIZE (3 * SCREEN_BOTTOM_WIDTH * SCREEN_HEIGHT)
+#define GPU_COPY_MAX_SIZE    (0xFFFF << 4) //TextureCopy line widths are 16-bit, in 16 bytes units
 
 static volatile struct fb {
      u8 *top_left;
@@ -46,8 +47,11 @@ static volatile struct fb {
      u8 *bottom;
 } *const fbs = (volatile struct fb *)0x23FFFE00;
 
+void startArm11Function(void (*func)());
+void waitForArm11Function(void);
 void deinitScreens(void);
 void swapFramebuffers(bool isAlternate);
 void updateBrightness(u32 brightnessIndex);
 void clearScreens(bool clearTop, bool clearBottom, bool clearAlternate);
+void gpuCopy(void *dst, const void *src, u32 size);
 void initScreens(void);
\ No newline at end of file
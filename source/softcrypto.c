@@ -0,0 +1,479 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   AES-128 and SHA-256 follow FIPS-197 and FIPS-180-4
+*   Key scrambler from https://www.3dbrew.org/wiki/AES_Registers#Key_Scrambler
+*/
+
+#include "softcrypto.h"
+#include "crypto.h"
+#include "memory.h"
+
+#ifdef __AES__
+#include <wmmintrin.h>
+#endif
+
+/****************************************************************
+*                  AES
+****************************************************************/
+
+static const u8 sbox[256] = {
+    0x63, 0x7C, 0x77, 0x7B, 0xF2, 0x6B, 0x6F, 0xC5, 0x30, 0x01, 0x67, 0x2B, 0xFE, 0xD7, 0xAB, 0x76,
+    0xCA, 0x82, 0xC9, 0x7D, 0xFA, 0x59, 0x47, 0xF0, 0xAD, 0xD4, 0xA2, 0xAF, 0x9C, 0xA4, 0x72, 0xC0,
+    0xB7, 0xFD, 0x93, 0x26, 0x36, 0x3F, 0xF7, 0xCC, 0x34, 0xA5, 0xE5, 0xF1, 0x71, 0xD8, 0x31, 0x15,
+    0x04, 0xC7, 0x23, 0xC3, 0x18, 0x96, 0x05, 0x9A, 0x07, 0x12, 0x80, 0xE2, 0xEB, 0x27, 0xB2, 0x75,
+    0x09, 0x83, 0x2C, 0x1A, 0x1B, 0x6E, 0x5A, 0xA0, 0x52, 0x3B, 0xD6, 0xB3, 0x29, 0xE3, 0x2F, 0x84,
+    0x53, 0xD1, 0x00, 0xED, 0x20, 0xFC, 0xB1, 0x5B, 0x6A, 0xCB, 0xBE, 0x39, 0x4A, 0x4C, 0x58, 0xCF,
+    0xD0, 0xEF, 0xAA, 0xFB, 0x43, 0x4D, 0x33, 0x85, 0x45, 0xF9, 0x02, 0x7F, 0x50, 0x3C, 0x9F, 0xA8,
+    0x51, 0xA3, 0x40, 0x8F, 0x92, 0x9D, 0x38, 0xF5, 0xBC, 0xB6, 0xDA, 0x21, 0x10, 0xFF, 0xF3, 0xD2,
+    0xCD, 0x0C, 0x13, 0xEC, 0x5F, 0x97, 0x44, 0x17, 0xC4, 0xA7, 0x7E, 0x3D, 0x64, 0x5D, 0x19, 0x73,
+    0x60, 0x81, 0x4F, 0xDC, 0x22, 0x2A, 0x90, 0x88, 0x46, 0xEE, 0xB8, 0x14, 0xDE, 0x5E, 0x0B, 0xDB,
+    0xE0, 0x32, 0x3A, 0x0A, 0x49, 0x06, 0x24, 0x5C, 0xC2, 0xD3, 0xAC, 0x62, 0x91, 0x95, 0xE4, 0x79,
+    0xE7, 0xC8, 0x37, 0x6D, 0x8D, 0xD5, 0x4E, 0xA9, 0x6C, 0x56, 0xF4, 0xEA, 0x65, 0x7A, 0xAE, 0x08,
+    0xBA, 0x78, 0x25, 0x2E, 0x1C, 0xA6, 0xB4, 0xC6, 0xE8, 0xDD, 0x74, 0x1F, 0x4B, 0xBD, 0x8B, 0x8A,
+    0x70, 0x3E, 0xB5, 0x66, 0x48, 0x03, 0xF6, 0x0E, 0x61, 0x35, 0x57, 0xB9, 0x86, 0xC1, 0x1D, 0x9E,
+    0xE1, 0xF8, 0x98, 0x11, 0x69, 0xD9, 0x8E, 0x94, 0x9B, 0x1E, 0x87, 0xE9, 0xCE, 0x55, 0x28, 0xDF,
+    0x8C, 0xA1, 0x89, 0x0D, 0xBF, 0xE6, 0x42, 0x68, 0x41, 0x99, 0x2D, 0x0F, 0xB0, 0x54, 0xBB, 0x16
+};
+
+static u8 keyXs[0x40][AES_BLOCK_SIZE],
+          keyYs[0x40][AES_BLOCK_SIZE],
+          normalKeys[0x40][AES_BLOCK_SIZE];
+
+//Expanded keys of the selected keyslot
+static u8 roundKeys[11 * AES_BLOCK_SIZE];
+
+static inline u8 xtime(u8 x)
+{
+    return (u8)((x << 1) ^ ((x & 0x80) ? 0x1B : 0));
+}
+
+static void expandKey(const u8 *key)
+{
+    u8 rcon = 1;
+
+    memcpy(roundKeys, key, AES_BLOCK_SIZE);
+
+    for(u32 i = AES_BLOCK_SIZE; i < sizeof(roundKeys); i += 4)
+    {
+        u8 t[4] = {roundKeys[i - 4], roundKeys[i - 3], roundKeys[i - 2], roundKeys[i - 1]};
+
+        if(i % AES_BLOCK_SIZE == 0)
+        {
+            u8 t0 = t[0];
+            t[0] = sbox[t[1]] ^ rcon;
+            t[1] = sbox[t[2]];
+            t[2] = sbox[t[3]];
+            t[3] = sbox[t0];
+            rcon = xtime(rcon);
+        }
+
+        for(u32 j = 0; j < 4; j++)
+            roundKeys[i + j] = roundKeys[i + j - AES_BLOCK_SIZE] ^ t[j];
+    }
+}
+
+#ifdef __AES__
+static void encryptBlock(u8 *out, const u8 *in)
+{
+    __m128i m = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in), _mm_loadu_si128((const __m128i *)roundKeys));
+
+    for(u32 i = 1; i < 10; i++)
+        m = _mm_aesenc_si128(m, _mm_loadu_si128((const __m128i *)(roundKeys + i * AES_BLOCK_SIZE)));
+
+    _mm_storeu_si128((__m128i *)out, _mm_aesenclast_si128(m, _mm_loadu_si128((const __m128i *)(roundKeys + 10 * AES_BLOCK_SIZE))));
+}
+
+static void decryptBlock(u8 *out, const u8 *in)
+{
+    __m128i m = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in), _mm_loadu_si128((const __m128i *)(roundKeys + 10 * AES_BLOCK_SIZE)));
+
+    for(u32 i = 9; i > 0; i--)
+        m = _mm_aesdec_si128(m, _mm_aesimc_si128(_mm_loadu_si128((const __m128i *)(roundKeys + i * AES_BLOCK_SIZE))));
+
+    _mm_storeu_si128((__m128i *)out, _mm_aesdeclast_si128(m, _mm_loadu_si128((const __m128i *)roundKeys)));
+}
+#else
+static u8 invSbox[256];
+
+static u8 gmul(u8 a, u8 b)
+{
+    u8 res = 0;
+
+    for(; b != 0; b >>= 1, a = xtime(a))
+        if(b & 1) res ^= a;
+
+    return res;
+}
+
+static void mixColumns(u8 *s, const u8 *coefs)
+{
+    for(u32 c = 0; c < 4; c++)
+    {
+        u8 *col = s + c * 4,
+           a[4] = {col[0], col[1], col[2], col[3]};
+
+        for(u32 r = 0; r < 4; r++)
+            col[r] = gmul(a[0], coefs[(4 - r) % 4]) ^ gmul(a[1], coefs[(5 - r) % 4]) ^
+                     gmul(a[2], coefs[(6 - r) % 4]) ^ gmul(a[3], coefs[(7 - r) % 4]);
+    }
+}
+
+static void encryptBlock(u8 *out, const u8 *in)
+{
+    static const u8 coefs[4] = {2, 3, 1, 1};
+    u8 s[AES_BLOCK_SIZE],
+       t[AES_BLOCK_SIZE];
+
+    for(u32 i = 0; i < AES_BLOCK_SIZE; i++)
+        s[i] = in[i] ^ roundKeys[i];
+
+    for(u32 round = 1; round <= 10; round++)
+    {
+        //SubBytes and ShiftRows
+        for(u32 i = 0; i < AES_BLOCK_SIZE; i++)
+            t[i] = sbox[s[(i + (i % 4) * 4) % AES_BLOCK_SIZE]];
+
+        if(round != 10) mixColumns(t, coefs);
+
+        for(u32 i = 0; i < AES_BLOCK_SIZE; i++)
+            s[i] = t[i] ^ roundKeys[round * AES_BLOCK_SIZE + i];
+    }
+
+    memcpy(out, s, AES_BLOCK_SIZE);
+}
+
+static void decryptBlock(u8 *out, const u8 *in)
+{
+    static const u8 coefs[4] = {14, 11, 13, 9};
+    u8 s[AES_BLOCK_SIZE],
+       t[AES_BLOCK_SIZE];
+
+    for(u32 i = 0; i < AES_BLOCK_SIZE; i++)
+        s[i] = in[i] ^ roundKeys[10 * AES_BLOCK_SIZE + i];
+
+    for(u32 round = 9; round != (u32)-1; round--)
+    {
+        //InvShiftRows and InvSubBytes
+        for(u32 i = 0; i < AES_BLOCK_SIZE; i++)
+            t[i] = invSbox[s[(i + AES_BLOCK_SIZE - (i % 4) * 4) % AES_BLOCK_SIZE]];
+
+        for(u32 i = 0; i < AES_BLOCK_SIZE; i++)
+            t[i] ^= roundKeys[round * AES_BLOCK_SIZE + i];
+
+        if(round != 0) mixColumns(t, coefs);
+
+        memcpy(s, t, AES_BLOCK_SIZE);
+    }
+
+    memcpy(out, s, AES_BLOCK_SIZE);
+}
+#endif
+
+//Big endian 128-bit helpers for the key scrambler
+static void load128(u64 *x, const u8 *src)
+{
+    x[0] = x[1] = 0;
+    for(u32 i = 0; i < 8; i++)
+    {
+        x[0] = (x[0] << 8) | src[i];
+        x[1] = (x[1] << 8) | src[i + 8];
+    }
+}
+
+static void store128(u8 *dst, const u64 *x)
+{
+    for(u32 i = 0; i < 8; i++)
+    {
+        dst[i] = (u8)(x[0] >> (56 - i * 8));
+        dst[i + 8] = (u8)(x[1] >> (56 - i * 8));
+    }
+}
+
+static void rol128(u64 *x, u32 n)
+{
+    u64 hi = x[0],
+        lo = x[1];
+
+    if(n >= 64)
+    {
+        hi = x[1];
+        lo = x[0];
+        n -= 64;
+    }
+
+    if(n != 0)
+    {
+        x[0] = (hi << n) | (lo >> (64 - n));
+        x[1] = (lo << n) | (hi >> (64 - n));
+    }
+    else
+    {
+        x[0] = hi;
+        x[1] = lo;
+    }
+}
+
+//NormalKey = (((KeyX <<< 2) ^ KeyY) + C) <<< 87
+static void scrambleKey(u8 keyslot)
+{
+    static const u64 c[2] = {0x1FF9E9AAC5FE0408ULL, 0x024591DC5D52768AULL};
+    u64 x[2],
+        y[2];
+
+    load128(x, keyXs[keyslot]);
+    load128(y, keyYs[keyslot]);
+
+    rol128(x, 2);
+    x[0] ^= y[0];
+    x[1] ^= y[1];
+
+    u64 lo = x[1] + c[1];
+    x[0] += c[0] + (lo < x[1]);
+    x[1] = lo;
+
+    rol128(x, 87);
+    store128(normalKeys[keyslot], x);
+}
+
+void aes_setkey(u8 keyslot, const void *key, u32 keyType, u32 mode)
+{
+    (void)mode;
+
+    if(keyslot <= 0x03 || keyslot > 0x3F) return; //Ignore TWL keys, like the hardware backend
+
+    switch(keyType)
+    {
+        case AES_KEYX:
+            memcpy(keyXs[keyslot], key, AES_BLOCK_SIZE);
+            break;
+        case AES_KEYY:
+            memcpy(keyYs[keyslot], key, AES_BLOCK_SIZE);
+            scrambleKey(keyslot);
+            break;
+        default:
+            memcpy(normalKeys[keyslot], key, AES_BLOCK_SIZE);
+            break;
+    }
+}
+
+void aes_use_keyslot(u8 keyslot)
+{
+    if(keyslot > 0x3F)
+        return;
+
+#ifndef __AES__
+    if(invSbox[0] == 0)
+        for(u32 i = 0; i < 256; i++)
+            invSbox[sbox[i]] = (u8)i;
+#endif
+
+    //Like the hardware, later changes to the keyslot need it to be selected again
+    expandKey(normalKeys[keyslot]);
+}
+
+static void xorBlock(u8 *dst, const u8 *a, const u8 *b)
+{
+    for(u32 i = 0; i < AES_BLOCK_SIZE; i++)
+        dst[i] = a[i] ^ b[i];
+}
+
+void aes(void *dst, const void *src, u32 blockCount, void *iv, u32 mode, u32 ivMode)
+{
+    (void)ivMode;
+
+    const u8 *in = (const u8 *)src;
+    u8 *out = (u8 *)dst,
+       *iv8 = (u8 *)iv,
+       block[AES_BLOCK_SIZE];
+
+    for(; blockCount != 0; blockCount--, in += AES_BLOCK_SIZE, out += AES_BLOCK_SIZE)
+    {
+        switch(mode & AES_ALL_MODES)
+        {
+            case AES_CTR_MODE:
+                encryptBlock(block, iv8);
+                xorBlock(out, in, block);
+                for(u32 i = AES_BLOCK_SIZE; i > 0 && ++iv8[i - 1] == 0; i--);
+                break;
+            case AES_CBC_DECRYPT_MODE:
+                memcpy(block, in, AES_BLOCK_SIZE);
+                decryptBlock(out, in);
+                xorBlock(out, out, iv8);
+                memcpy(iv8, block, AES_BLOCK_SIZE);
+                break;
+            case AES_CBC_ENCRYPT_MODE:
+                xorBlock(block, in, iv8);
+                encryptBlock(out, block);
+                memcpy(iv8, out, AES_BLOCK_SIZE);
+                break;
+            case AES_ECB_DECRYPT_MODE:
+                decryptBlock(out, in);
+                break;
+            case AES_ECB_ENCRYPT_MODE:
+                encryptBlock(out, in);
+                break;
+            default: //CCM isn't used by crypto.c
+                return;
+        }
+    }
+}
+
+/****************************************************************
+*                  SHA
+****************************************************************/
+
+static const u32 sha256K[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256Block(u32 *state, const u8 *block)
+{
+    u32 w[64];
+
+    for(u32 i = 0; i < 16; i++)
+        w[i] = ((u32)block[i * 4] << 24) | ((u32)block[i * 4 + 1] << 16) | ((u32)block[i * 4 + 2] << 8) | block[i * 4 + 3];
+
+    for(u32 i = 16; i < 64; i++)
+    {
+        u32 s0 = ROR32(w[i - 15], 7) ^ ROR32(w[i - 15], 18) ^ (w[i - 15] >> 3),
+            s1 = ROR32(w[i - 2], 17) ^ ROR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    u32 a = state[0], b = state[1], c = state[2], d = state[3],
+        e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for(u32 i = 0; i < 64; i++)
+    {
+        u32 t1 = h + (ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25)) + ((e & f) ^ (~e & g)) + sha256K[i] + w[i],
+            t2 = (ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+//SHA-1 isn't used by crypto.c, only SHA-256 and SHA-224 are implemented.
+//Like the hardware engine, there is a single hash in progress at a time
+static u32 shaState[8],
+           shaMode,
+           shaBufferSize;
+static u8 __attribute__((aligned(4))) shaBuffer[0x40];
+static u64 shaSize;
+
+void sha_init(u32 mode)
+{
+    static const u32 sha256Init[8] = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19},
+                     sha224Init[8] = {0xC1059ED8, 0x367CD507, 0x3070DD17, 0xF70E5939, 0xFFC00B31, 0x68581511, 0x64F98FA7, 0xBEFA4FA4};
+
+    memcpy(shaState, mode == SHA_224_MODE ? sha224Init : sha256Init, sizeof(shaState));
+    shaMode = mode;
+    shaBufferSize = 0;
+    shaSize = 0;
+}
+
+void sha_update(const void *src, u32 size)
+{
+    const u8 *src8 = (const u8 *)src;
+    shaSize += size;
+
+    if(shaBufferSize != 0)
+    {
+        u32 fill = sizeof(shaBuffer) - shaBufferSize;
+        if(fill > size) fill = size;
+
+        memcpy(shaBuffer + shaBufferSize, src8, fill);
+        shaBufferSize += fill;
+        src8 += fill;
+        size -= fill;
+
+        if(shaBufferSize < sizeof(shaBuffer)) return;
+
+        sha256Block(shaState, shaBuffer);
+        shaBufferSize = 0;
+    }
+
+    for(; size >= sizeof(shaBuffer); size -= sizeof(shaBuffer), src8 += sizeof(shaBuffer))
+        sha256Block(shaState, src8);
+
+    memcpy(shaBuffer, src8, size);
+    shaBufferSize = size;
+}
+
+void sha_final(void *res)
+{
+    u64 bitCount = shaSize * 8;
+
+    //Padding
+    shaBuffer[shaBufferSize] = 0x80;
+    for(u32 i = shaBufferSize + 1; i < sizeof(shaBuffer); i++)
+        shaBuffer[i] = 0;
+
+    if(shaBufferSize >= 56)
+    {
+        sha256Block(shaState, shaBuffer);
+        memset32(shaBuffer, 0, sizeof(shaBuffer));
+    }
+
+    for(u32 i = 0; i < 8; i++)
+        shaBuffer[56 + i] = (u8)(bitCount >> (56 - i * 8));
+    sha256Block(shaState, shaBuffer);
+
+    u8 *res8 = (u8 *)res;
+    u32 hashSize = shaMode == SHA_224_MODE ? SHA_224_HASH_SIZE : SHA_256_HASH_SIZE;
+
+    for(u32 i = 0; i < hashSize; i++)
+        res8[i] = (u8)(shaState[i / 4] >> (24 - (i % 4) * 8));
+}
+
+void sha(void *res, const void *src, u32 size, u32 mode)
+{
+    sha_init(mode);
+    sha_update(src, size);
+    sha_final(res);
+}
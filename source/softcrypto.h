@@ -0,0 +1,37 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   Software AES and SHA engines for host builds of crypto.c (-DCRYPTO_SOFTWARE), AES-NI is used when built with -maes
+*   Keyslots behave like the hardware ones: writing a keyY derives the normal key from the keyX with the key scrambler
+*/
+
+#pragma once
+
+#include "types.h"
+
+/* Only the byte and word order used by crypto.c (AES_INPUT_BE | AES_INPUT_NORMAL for keys and IVs) is supported.
+   Host tools set the bootROM keyXs/normal keys themselves with aes_setkey */
+void aes_setkey(u8 keyslot, const void *key, u32 keyType, u32 mode);
+void aes_use_keyslot(u8 keyslot);
+void aes(void *dst, const void *src, u32 blockCount, void *iv, u32 mode, u32 ivMode);
+void sha(void *res, const void *src, u32 size, u32 mode);
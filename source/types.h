@@ -39,6 +39,17 @@ typedef volatile u64 vu64;
 //Used by multiple files
 #define BRAHMA_ARM11_ENTRY 0x1FFFFFF8
 
+//Console-specific builds know the console at compile time (and refuse to boot on anything else)
+#if defined(BUILD_O3DS)
+#define isN3DS false
+#define isDevUnit false
+#elif defined(BUILD_N3DS)
+#define isN3DS true
+#define isDevUnit false
+#else
+extern bool isN3DS, isDevUnit;
+#endif
+
 typedef enum FirmwareSource
 {
     FIRMWARE_SYSNAND = 0,
@@ -0,0 +1,196 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   About the ARM11 worker:
+*
+*   The ARM11 doesn't go through the ARM9 data cache, so every job flushes it before being published.
+*   The ARM9 must not touch the buffers of a job until it has waited for it, and must wait for a job
+*   before submitting ARM11_WORKER_QUEUE_SIZE more of them, as its slot (and result) gets reused.
+*   When the worker isn't running (i.e. on firmlaunches), jobs are run right away on the ARM9.
+*/
+
+#include "worker.h"
+#include "memory.h"
+#include "cache.h"
+#include "screen.h"
+
+extern vu32 *const arm11Entry; //Defined in screen.c
+
+#ifdef ARM11_WORKER_HOST_MODEL
+//Lets the other side run when the host has fewer cores than the console
+void arm11ModelSpin(void);
+#define SPIN() arm11ModelSpin()
+#else
+#define SPIN()
+#endif
+
+static Arm11JobQueue queue;
+static bool isWorkerRunning = false;
+
+static void runJob(Arm11Job *job)
+{
+    switch(job->type)
+    {
+        case ARM11_JOB_COPY:
+            memcpy(job->dst, job->src, job->size);
+            break;
+        case ARM11_JOB_SEARCH:
+            job->result = memsearch(job->dst, job->src, job->size, job->patternSize);
+            break;
+        case ARM11_JOB_DECOMPRESS:
+            job->result = (void *)decompressLz(job->dst, job->src);
+            break;
+        default:
+            break;
+    }
+}
+
+static void workerLoop(void)
+{
+    u32 tail = queue.tail;
+    bool exit = false;
+
+    while(!exit)
+    {
+        //Wait for the ARM9 to publish a job. The job itself isn't volatile, keep the compiler
+        //from reading it before head has moved or writing its result after tail has
+        while(queue.head == tail) SPIN();
+        __asm volatile("" : : : "memory");
+
+        Arm11Job *job = &queue.jobs[tail % ARM11_WORKER_QUEUE_SIZE];
+        exit = job->type == ARM11_JOB_EXIT;
+        runJob(job);
+
+        __asm volatile("" : : : "memory");
+        queue.tail = ++tail;
+    }
+}
+
+#ifdef ARM11_WORKER_HOST_MODEL
+//hostsim runs the worker on a thread, see hostsim/source/arm11.c
+static void arm11WorkerEntry(void)
+{
+    workerLoop();
+}
+#else
+static void __attribute__((naked)) arm11WorkerEntry(void)
+{
+    //Disable interrupts
+    __asm(".word 0xF10C01C0");
+
+    //Don't rely on whatever stack the ARM11 was left with, use the free FCRAM right below the stub
+    __asm("ldr sp, =0x24FFFFD0");
+
+    workerLoop();
+
+    WAIT_FOR_ARM9();
+}
+#endif
+
+static u32 readTail(void)
+{
+    flushDCacheRange((void *)&queue.tail, 4);
+    return queue.tail;
+}
+
+static u32 submitJob(Arm11JobType type, u8 *dst, const void *src, u32 size, u32 patternSize)
+{
+    u32 job = queue.head;
+
+    //Wait for a free slot
+    if(isWorkerRunning) while(job - readTail() >= ARM11_WORKER_QUEUE_SIZE) SPIN();
+
+    Arm11Job *slot = &queue.jobs[job % ARM11_WORKER_QUEUE_SIZE];
+    slot->type = type;
+    slot->dst = dst;
+    slot->src = src;
+    slot->size = size;
+    slot->patternSize = patternSize;
+    slot->result = NULL;
+
+    if(!isWorkerRunning)
+    {
+        runJob(slot);
+        queue.head = queue.tail = job + 1;
+    }
+    else
+    {
+        //Make the job and its buffers visible to the ARM11
+        flushEntireDCache();
+
+        queue.head = job + 1;
+        flushDCacheRange((void *)&queue.head, 4);
+    }
+
+    return job;
+}
+
+void startArm11Worker(void)
+{
+    //On firmlaunches the ARM11 is held by the kernel, not by us
+    if(isWorkerRunning || isFirmlaunch) return;
+
+    queue.head = queue.tail = 0;
+    flushEntireDCache();
+
+    isWorkerRunning = true;
+    startArm11Function(arm11WorkerEntry);
+}
+
+void stopArm11Worker(void)
+{
+    if(!isWorkerRunning) return;
+
+    arm11WorkerWait(submitJob(ARM11_JOB_EXIT, NULL, NULL, 0, 0));
+    isWorkerRunning = false;
+
+    waitForArm11Function();
+}
+
+u32 arm11WorkerCopy(void *dest, const void *src, u32 size)
+{
+    return submitJob(ARM11_JOB_COPY, (u8 *)dest, src, size, 0);
+}
+
+u32 arm11WorkerSearch(u8 *startPos, const void *pattern, u32 size, u32 patternSize)
+{
+    return submitJob(ARM11_JOB_SEARCH, startPos, pattern, size, patternSize);
+}
+
+u32 arm11WorkerDecompress(void *dest, const void *src)
+{
+    return submitJob(ARM11_JOB_DECOMPRESS, (u8 *)dest, src, 0, 0);
+}
+
+void *arm11WorkerWait(u32 job)
+{
+    Arm11Job *slot = &queue.jobs[job % ARM11_WORKER_QUEUE_SIZE];
+
+    if(isWorkerRunning)
+    {
+        while(readTail() <= job) SPIN();
+        flushDCacheRange(slot, sizeof(Arm11Job));
+    }
+
+    return slot->result;
+}
@@ -0,0 +1,72 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b of GPLv3 applies to this file: Requiring preservation of specified
+*   reasonable legal notices or author attributions in that material or in the Appropriate Legal
+*   Notices displayed by works containing it.
+*/
+
+/*
+*   Offloads CPU-bound work (copies, pattern searches, decompression) to the otherwise idle ARM11 during boot.
+*   Jobs go through a single-producer (ARM9) single-consumer (ARM11) ring, no locking needed.
+*/
+
+#pragma once
+
+#include "types.h"
+
+#define ARM11_WORKER_QUEUE_SIZE  8
+
+//VRAM, AXI WRAM and FCRAM are shared, the rest is ARM9-only
+#define ARM11_CAN_ACCESS(addr)   ((u32)(addr) >= 0x18000000)
+
+typedef enum Arm11JobType
+{
+    ARM11_JOB_COPY = 0,
+    ARM11_JOB_SEARCH,
+    ARM11_JOB_DECOMPRESS,
+    ARM11_JOB_EXIT
+} Arm11JobType;
+
+//Each job fills a whole cache line, so that the ARM9 never writes back stale results
+typedef struct __attribute__((aligned(32))) Arm11Job
+{
+    u32 type;
+    u8 *dst;
+    const void *src;
+    u32 size;
+    u32 patternSize;
+    void *result;
+} Arm11Job;
+
+typedef struct __attribute__((aligned(32))) Arm11JobQueue
+{
+    vu32 head; //Only written by the ARM9
+    u8 reserved1[28];
+    vu32 tail; //Only written by the ARM11
+    u8 reserved2[28];
+    Arm11Job jobs[ARM11_WORKER_QUEUE_SIZE];
+} Arm11JobQueue;
+
+extern bool isFirmlaunch;
+
+void startArm11Worker(void);
+void stopArm11Worker(void);
+u32 arm11WorkerCopy(void *dest, const void *src, u32 size);
+u32 arm11WorkerSearch(u8 *startPos, const void *pattern, u32 size, u32 patternSize);
+u32 arm11WorkerDecompress(void *dest, const void *src);
+void *arm11WorkerWait(u32 job);